@@ -160,11 +160,95 @@ void SDS_append_fmt (uint iter)
 	sdsfree(s);
 }
 
+// same output as FMT, ARG
+void STX_append_typed (uint iter)
+{
+    const int fmtlen = snprintf(NULL, 0, FMT, ARG);
+
+	stx_t s = stx_from("");
+	
+	BENCHBEG
+		FOR(i,iter) {
+			stx_append_many (&s, "foo", " ", "bar", " ", NULL);
+			stx_append_int (&s, 10);
+		}
+	BENCHEND("typed")
+	
+	assert (stx_len(s)==fmtlen*iter);
+	stx_free(s);
+}
+
+#define NUM_FMT(label, call) { \
+	stx_t s = stx_from(""); \
+	BENCHBEG \
+		FOR(i,iter) call; \
+	BENCHEND(label) \
+	stx_free(s); \
+}
+
+void STX_append_nums (uint iter)
+{
+	LOG("integers :");
+	NUM_FMT("fmt", stx_append_fmt (&s, "%ld", (long)i*7919));
+	NUM_FMT("typed", stx_append_int (&s, (long)i*7919));
+	LOG("hex :");
+	NUM_FMT("fmt", stx_append_fmt (&s, "%lx", i*7919));
+	NUM_FMT("typed", stx_append_hex (&s, i*7919));
+	LOG("doubles %%.3f :");
+	NUM_FMT("fmt", stx_append_fmt (&s, "%.3f", i/7.0));
+	NUM_FMT("typed", stx_append_double (&s, i/7.0, 3));
+	LOG("doubles shortest :");
+	NUM_FMT("fmt %.17g", stx_append_fmt (&s, "%.17g", i/8.0));
+	NUM_FMT("typed", stx_append_double (&s, i/8.0, -1));
+}
+
+// 4KB outputs, past the 1KB local buffer, onto one growing strick :
+// mostly fits (scratch buffer). Once the content outgrows the output,
+// growth goes through realloc rather than a new block.
+void STX_append_fmt_long (uint iter)
+{
+	stx_t s = stx_from("");
+	
+	BENCHBEG
+		FOR(i,iter) stx_append_fmt (&s, "%s %d", W4096, (int)i);
+	BENCHEND("long")
+	
+	stx_free(s);
+}
+
+// 4KB outputs onto fresh stricks : every call grows
+void STX_append_fmt_long_grow (uint iter)
+{
+	BENCHBEG
+		FOR(i,iter) {
+			stx_t s = stx_from("");
+			stx_append_fmt (&s, "%s %d", W4096, (int)i);
+			stx_free(s);
+		}
+	BENCHEND("long grow")
+}
+
+void SDS_append_fmt_long (uint iter)
+{
+	sds s = sdsnew("");
+
+	BENCHBEG
+		FOR(i,iter) s = sdscatprintf (s, "%s %d", W4096, (int)i);
+	BENCHEND("SDS long")
+	
+	sdsfree(s);
+}
+
 void append_fmt()
 {
 	SECTION("append format")
 	SDS_append_fmt (5000000);
 	STX_append_fmt (5000000);
+	SDS_append_fmt_long (200000);
+	STX_append_fmt_long (200000);
+	STX_append_fmt_long_grow (200000);
+	STX_append_typed (5000000);
+	STX_append_nums (5000000);
 }
 //==============================================================================
 
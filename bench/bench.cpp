@@ -6,13 +6,14 @@
 #include <benchmark/benchmark.h>
 #include <string>
 #include <array>
+#include <vector>
 
 // ClobberMemory() : avoids optimize-out
 
 extern "C" {
 #include "sds/sds.h"
-#include "../src/stx.h"
 }
+#include "../src/stx.hpp"
 
 static std::string randStr(size_t n) 
 {
@@ -26,7 +27,8 @@ static std::string randStr(size_t n)
 // ==== Init and free ==================================================
 
 #define INIT_FREE(Type, New, Free) \
-	const char* src = randStr(state.range(0)).c_str(); \
+	const std::string ssrc = randStr(state.range(0)); \
+	const char* src = ssrc.c_str(); \
 	const size_t srclen = strlen(src); \
 	for (auto _ : state) { \
 		Type s = New(src, srclen); \
@@ -50,7 +52,8 @@ SDS_from (benchmark::State& state) {
 static void 
 STX_append (benchmark::State& state) 
 {
-	const char* src = randStr(state.range(0)).c_str();
+	const std::string ssrc = randStr(state.range(0));
+	const char* src = ssrc.c_str();
 	const size_t srclen = strlen(src);
 	stx_t s = stx_from("");
 
@@ -64,7 +67,8 @@ STX_append (benchmark::State& state)
 static void 
 SDS_append (benchmark::State& state) 
 {
-	const char* src = randStr(state.range(0)).c_str();
+	const std::string ssrc = randStr(state.range(0));
+	const char* src = ssrc.c_str();
 	const size_t srclen = strlen(src);
 	sds s = sdsnew("");
 
@@ -75,6 +79,98 @@ SDS_append (benchmark::State& state)
 	sdsfree(s);
 }
 
+// HTTP-like header line from 6 fragments
+#define FRAGS "Content-Type", ": ", "text/html", "; charset=", "utf-8", "\r\n"
+
+static void 
+STX_append_each (benchmark::State& state) 
+{
+	const char* frags[] = {FRAGS};
+	stx_t s = stx_new(0);
+
+	for (auto _ : state) {
+		for (const char* f : frags) stx_append (&s, f, strlen(f));
+		stx_reset(s);
+	}
+	benchmark::ClobberMemory();
+	stx_free(s);
+}
+
+static void 
+STX_appendv (benchmark::State& state) 
+{
+	const char* frags[] = {FRAGS};
+	stx_view parts[6];
+	for (int i = 0; i < 6; ++i) parts[i] = {frags[i], strlen(frags[i])};
+	stx_t s = stx_new(0);
+
+	for (auto _ : state) {
+		stx_appendv (&s, parts, 6);
+		stx_reset(s);
+	}
+	benchmark::ClobberMemory();
+	stx_free(s);
+}
+
+static void 
+STX_append_many (benchmark::State& state) 
+{
+	stx_t s = stx_new(0);
+
+	for (auto _ : state) {
+		stx_append_many (&s, FRAGS, NULL);
+		stx_reset(s);
+	}
+	benchmark::ClobberMemory();
+	stx_free(s);
+}
+
+//==== Formatting =============================================
+
+#define LOG_FMT "%s \t (+%d) %s %x\n"
+#define LOG_ARGS "alice", 42, "hello world", 0xbeef
+
+static void 
+STX_append_fmt (benchmark::State& state) 
+{
+	stx_t s = stx_new(0);
+
+	for (auto _ : state) {
+		stx_append_fmt (&s, LOG_FMT, LOG_ARGS);
+		stx_reset(s);
+	}
+	benchmark::ClobberMemory();
+	stx_free(s);
+}
+
+static void 
+STX_append_cfmt (benchmark::State& state) 
+{
+	stx_fmt* f = stx_fmt_compile(LOG_FMT);
+	stx_t s = stx_new(0);
+
+	for (auto _ : state) {
+		stx_append_cfmt (&s, f, LOG_ARGS);
+		stx_reset(s);
+	}
+	benchmark::ClobberMemory();
+	stx_free(s);
+	stx_fmt_free(f);
+}
+
+static void 
+STX_append_hpp (benchmark::State& state) 
+{
+	stx_t s = stx_new(0);
+
+	for (auto _ : state) {
+		stx::append (&s, STX_FMT(LOG_FMT), LOG_ARGS);
+		stx_reset(s);
+	}
+	benchmark::ClobberMemory();
+	stx_free(s);
+}
+
 // static void 
 // std_append(benchmark::State& state) 
 // {
@@ -86,6 +182,281 @@ SDS_append (benchmark::State& state)
 // 	benchmark::ClobberMemory();
 // }
 
+//==== Large join =============================================
+
+// 256K parts of 256 bytes, joined on state.range(0) threads
+static void 
+STX_join_large (benchmark::State& state) 
+{
+	const int count = 1<<18;
+	const std::string part = randStr(256);
+	std::vector<stx_t> list(count);
+	for (auto& p : list) p = stx_from(part.c_str());
+	stx_set_parallel (state.range(0), 0);
+
+	for (auto _ : state) {
+		stx_t s = stx_join_len (list.data(), count, "\n", 1);
+		stx_free(s);
+	}
+
+	stx_set_parallel (0, STX_PAR_MIN);
+	for (auto p : list) stx_free(p);
+}
+
+//==== Large split ============================================
+
+// 64MB of 256-byte lines, split on state.range(0) threads
+static void 
+STX_split_large (benchmark::State& state) 
+{
+	std::string src;
+	const std::string line = randStr(255) + "\n";
+	while (src.size() < (64<<20)) src += line;
+	stx_set_parallel (state.range(0), 0);
+	int cnt;
+
+	for (auto _ : state) {
+		stx_view* list = stx_split_view (src.data(), src.size(), "\n", 1, &cnt);
+		free(list);
+	}
+
+	stx_set_parallel (0, STX_PAR_MIN);
+}
+
+//==== Trim ===================================================
+
+// Field padded with arg spaces each side, refilled every round
+#define TRIM_SRC \
+	const std::string pad(state.range(0), ' '); \
+	const std::string src = pad + "field value" + pad
+
+static void 
+STX_trim (benchmark::State& state) 
+{
+	TRIM_SRC;
+	stx_t s = stx_new(src.size());
+
+	for (auto _ : state) {
+		stx_reset(s);
+		stx_append(&s, src.data(), src.size());
+		stx_trim(s);
+		benchmark::DoNotOptimize(s);
+	}
+
+	stx_free(s);
+}
+
+static void 
+SDS_trim (benchmark::State& state) 
+{
+	TRIM_SRC;
+	sds s = sdsempty();
+
+	for (auto _ : state) {
+		s = sdscpylen(s, src.data(), src.size());
+		sdstrim(s, " \t\n\v\f\r");
+		benchmark::DoNotOptimize(s);
+	}
+
+	sdsfree(s);
+}
+
+//==== Find ===================================================
+
+// 1MB of 16 letters, needle of arg bytes taken near the end
+#define FIND_SRC \
+	std::string hay(1<<20, 0); \
+	srand(1); \
+	for (char& c : hay) c = 'a' + rand() % 16; \
+	const std::string pat = hay.substr(hay.size() - 1000, state.range(0))
+
+static void 
+STX_find (benchmark::State& state) 
+{
+	FIND_SRC;
+	stx_t s = stx_from_len(hay.data(), hay.size());
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize (stx_find(s, pat.data(), pat.size()));
+
+	stx_free(s);
+}
+
+static void 
+LIBC_memmem (benchmark::State& state) 
+{
+	FIND_SRC;
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize (memmem(hay.data(), hay.size(), pat.data(), pat.size()));
+}
+
+// Worst case for a candidate filter : "aa..b..aa" in "aaa..."
+static void 
+STX_find_periodic (benchmark::State& state) 
+{
+	const std::string hay(1<<20, 'a');
+	std::string pat(state.range(0), 'a');
+	pat[pat.size()/2] = 'b';
+	stx_t s = stx_from_len(hay.data(), hay.size());
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize (stx_find(s, pat.data(), pat.size()));
+
+	stx_free(s);
+}
+
+//==== Hash ===================================================
+
+static void 
+STX_hash (benchmark::State& state) 
+{
+	const std::string src = randStr(state.range(0));
+	stx_t s = stx_from(src.c_str());
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize (stx_hash(s));
+
+	stx_free(s);
+}
+
+static void 
+STX_hash_cached (benchmark::State& state) 
+{
+	const std::string src = randStr(state.range(0));
+	stx_t s = stx_from(src.c_str());
+	stx_hash_enable(&s);
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize (stx_hash(s));
+
+	stx_free(s);
+}
+
+//==== Sharing ================================================
+
+// Fan-out of one payload to 8 consumers
+#define FANOUT 8
+
+static void 
+STX_dup_copy (benchmark::State& state) 
+{
+	const std::string src = randStr(state.range(0));
+	stx_t s = stx_from(src.c_str());
+	stx_t copies[FANOUT];
+
+	for (auto _ : state) {
+		for (auto& c : copies) c = stx_dup(s);
+		for (auto c : copies) stx_free(c);
+	}
+	stx_free(s);
+}
+
+static void 
+STX_dup_shared (benchmark::State& state) 
+{
+	const std::string src = randStr(state.range(0));
+	stx_t s = stx_from(src.c_str());
+	stx_share_enable(&s);
+	stx_t copies[FANOUT];
+
+	for (auto _ : state) {
+		for (auto& c : copies) c = stx_dup(s);
+		for (auto c : copies) stx_free(c);
+	}
+	stx_free(s);
+}
+
+//==== Interning ==============================================
+
+#define SEP_NAMES "|"
+
+// Column of 1<<16 user names out of 2000
+static std::string 
+names_column() 
+{
+	std::string col;
+	for (int i = 0; i < (1<<16); ++i) {
+		if (i) col += SEP_NAMES;
+		col += "user" + std::to_string((i * 7919) % 2000);
+	}
+	return col;
+}
+
+static void 
+STX_split_names (benchmark::State& state) 
+{
+	const std::string col = names_column();
+	int cnt;
+
+	for (auto _ : state) {
+		stx_t* list = stx_split_len (col.data(), col.size(), SEP_NAMES, 1, &cnt);
+		stx_list_free(list);
+	}
+}
+
+static void 
+STX_intern_names (benchmark::State& state) 
+{
+	const std::string col = names_column();
+	stx_interns* t = stx_interns_create(state.range(0));
+	int cnt;
+
+	for (auto _ : state) {
+		stx_t* list = stx_split_len (col.data(), col.size(), SEP_NAMES, 1, &cnt);
+		stx_intern_list (t, list, cnt);
+		stx_list_free(list);
+	}
+	stx_interns_destroy(t);
+}
+
+//==== Mixed header types =====================================
+
+// Stricks of random head types, so type dispatch is unpredictable
+#define MIXED_COUNT (1<<14)
+
+static std::vector<stx_t> mixedList() 
+{
+	const size_t caps[] = {8, 8, 8, 8, 1000, 1000, 1000, 1000, 100000};
+	std::vector<stx_t> list;
+	uint32_t seed = 1;
+	for (int i = 0; i < MIXED_COUNT; ++i) {
+		seed = seed * 1103515245 + 12345;
+		list.push_back (stx_new(caps[(seed >> 16) % 9]));
+	}
+	return list;
+}
+
+static void 
+STX_len_mixed (benchmark::State& state) 
+{
+	std::vector<stx_t> list = mixedList();
+	size_t sum = 0;
+
+	for (auto _ : state) {
+		for (stx_t s : list) sum += stx_len(s);
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * MIXED_COUNT);
+	for (stx_t s : list) stx_free(s);
+}
+
+static void 
+STX_append_mixed (benchmark::State& state) 
+{
+	std::vector<stx_t> list = mixedList();
+
+	for (auto _ : state) {
+		for (stx_t& s : list) {
+			stx_append (&s, "ab", 2);
+			stx_reset (s);
+		}
+	}
+	benchmark::ClobberMemory();
+	state.SetItemsProcessed(state.iterations() * MIXED_COUNT);
+	for (stx_t s : list) stx_free(s);
+}
+
 //==== Split and join =========================================
 
 #define SPLIT_SEP "|"
@@ -117,6 +488,21 @@ STX_split_join (benchmark::State& state)
 	benchmark::ClobberMemory();
 }
 
+// separator scan only
+static void 
+STX_split_view (benchmark::State& state) 
+{
+	SPLIT_INIT
+
+    for (auto _ : state) {
+	    stx_view* parts = stx_split_view (src, srclen, SPLIT_SEP, seplen, &cnt);
+	    assert (cnt == count+1);
+		free(parts);
+	}
+
+	benchmark::ClobberMemory();
+}
+
 static void 
 SDS_split_join (benchmark::State& state) 
 {
@@ -144,7 +530,38 @@ BENCHMARK(STX_from)->RangeMultiplier(MULT)->Range(8, RANGE_END);
 BENCHMARK(SDS_append)->RangeMultiplier(MULT)->Range(8, RANGE_END);
 BENCHMARK(STX_append)->RangeMultiplier(MULT)->Range(8, RANGE_END);
 
+BENCHMARK(STX_append_each);
+BENCHMARK(STX_appendv);
+BENCHMARK(STX_append_many);
+
+BENCHMARK(STX_append_fmt);
+BENCHMARK(STX_append_cfmt);
+BENCHMARK(STX_append_hpp);
+
+BENCHMARK(STX_join_large)->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond);
+
+BENCHMARK(STX_split_large)->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond);
+BENCHMARK(SDS_trim)->RangeMultiplier(MULT)->Range(1, 512);
+BENCHMARK(STX_trim)->RangeMultiplier(MULT)->Range(1, 512);
+
+BENCHMARK(LIBC_memmem)->Arg(1)->Arg(8)->Arg(31)->Arg(32)->Arg(256)->Unit(benchmark::kMicrosecond);
+BENCHMARK(STX_find)->Arg(1)->Arg(8)->Arg(31)->Arg(32)->Arg(256)->Unit(benchmark::kMicrosecond);
+BENCHMARK(STX_find_periodic)->Arg(8)->Arg(31)->Arg(32)->Arg(256)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(STX_hash)->RangeMultiplier(MULT)->Range(8, RANGE_END);
+BENCHMARK(STX_hash_cached)->RangeMultiplier(MULT)->Range(8, RANGE_END);
+
+BENCHMARK(STX_dup_copy)->RangeMultiplier(MULT)->Range(8, RANGE_END);
+BENCHMARK(STX_dup_shared)->RangeMultiplier(MULT)->Range(8, RANGE_END);
+
+BENCHMARK(STX_split_names)->Unit(benchmark::kMicrosecond);
+BENCHMARK(STX_intern_names)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(STX_len_mixed);
+BENCHMARK(STX_append_mixed);
+
 BENCHMARK(SDS_split_join)->RangeMultiplier(MULT)->Range(8, RANGE_END)->Unit(benchmark::kMicrosecond);
 BENCHMARK(STX_split_join)->RangeMultiplier(MULT)->Range(8, RANGE_END)->Unit(benchmark::kMicrosecond);
+BENCHMARK(STX_split_view)->RangeMultiplier(MULT)->Range(8, RANGE_END)->Unit(benchmark::kMicrosecond);
 
 BENCHMARK_MAIN();
\ No newline at end of file
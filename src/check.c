@@ -11,6 +11,12 @@ NO WARRANTY EXPRESSED OR IMPLIED
 #include <assert.h>
 #include <errno.h>
 #include <stdarg.h>
+#include <pthread.h>
+#include <math.h>
+#include <limits.h>
+#ifdef __GLIBC__
+    #include <malloc.h> // malloc_usable_size
+#endif
 
 #include "stx.h"
 #include "util.c"
@@ -35,6 +41,7 @@ exit(1);}}
 
 #define CAP 100  
 #define SMALL_MAX 255
+#define MEDIUM_MAX 65535
 #define FOO "foo"
 #define BAR "bar"
 #define SEP "|"
@@ -69,6 +76,8 @@ static void new()
     u_new (SMALL_MAX);
     u_new (SMALL_MAX+1);
     u_new (1024);
+    u_new (MEDIUM_MAX);
+    u_new (MEDIUM_MAX+1);
     u_new (1024*1024); 
     u_new (32*1024*1024); 
 }
@@ -98,6 +107,8 @@ static void from()
     u_from (SMALL_MAX);
     u_from (SMALL_MAX+1);
     u_from (1024);
+    u_from (MEDIUM_MAX);
+    u_from (MEDIUM_MAX+1);
     u_from (1024*1024); 
     u_from (32*1024*1024); 
 }
@@ -211,6 +222,10 @@ void resize()
     u_resize_new (SMALL_MAX+1,0);
     u_resize_new (SMALL_MAX+1,SMALL_MAX);
     u_resize_new (SMALL_MAX+1,SMALL_MAX+2);
+    u_resize_new (SMALL_MAX+1,MEDIUM_MAX+1);
+
+    u_resize_new (MEDIUM_MAX+1,SMALL_MAX);
+    u_resize_new (MEDIUM_MAX+1,MEDIUM_MAX);
 
     u_resize_from ("", 0,   0, "");
     u_resize_from ("", CAP,   0, "");
@@ -250,17 +265,26 @@ void append()
     INIT (foolen  , foo, foolen, foolen, foo);
     INIT (foolen+1, foo, foolen, foolen, foo);
 
-    // TYPE1 -> TYPE4
+    // TYPE1 -> TYPE2
     INIT (0,        w1024, 1024, 1024, w1024);
     INIT (foolen,   w1024, 1024, 1024, w1024);
 
-    // TYPE4 -> TYPE4
+    // TYPE2 -> TYPE2
     INIT (1024,   w1024, 1024, 1024, w1024);
     INIT (1024,   w4096, 4096, 4096, w4096);
 
-    // TYPE4 -> TYPE1
+    // TYPE2 -> TYPE1
     INIT (1024,   foo, foolen, foolen, foo);
 
+    // TYPE1, TYPE2 -> TYPE4
+    {
+        char* big = str_nchar('a', MEDIUM_MAX+1);
+        INIT (0,        big, MEDIUM_MAX+1, MEDIUM_MAX+1, big);
+        INIT (1024,     big, MEDIUM_MAX+1, MEDIUM_MAX+1, big);
+        INIT (MEDIUM_MAX, big, MEDIUM_MAX+1, MEDIUM_MAX+1, big);
+        free(big);
+    }
+
     // cut
     INIT (0, foo, foolen-1, foolen-1, "fo");
     INIT (foolen-1, foo, foolen-1, foolen-1, "fo");
@@ -271,6 +295,349 @@ void append()
 }
 
 
+// Appends crossing every head type keep data and length
+void types()
+{
+    const size_t total = 2*(MEDIUM_MAX+1);
+    char* big = str_nchar('x', total);
+    stx_t s = stx_new(0);
+    size_t len = 0;
+
+    for (size_t n = 1; len < total; n *= 3) {
+        const size_t add = min(n, total-len);
+        ASSERT_INT (stx_append (&s, big, add), (len+add));
+        len += add;
+        ASSERT_INT (stx_len(s), len);
+        assert (stx_cap(s) >= len);
+        assert (!memcmp(s, big, len) && !s[len]);
+    }
+
+    stx_t d = stx_dup(s);
+    ASSERT_INT (stx_len(d), total);
+    assert (!memcmp(d, big, total));
+    
+    stx_resize (&s, SMALL_MAX);
+    ASSERT_INT (stx_len(s), SMALL_MAX);
+    assert (!memcmp(s, big, SMALL_MAX) && !s[SMALL_MAX]);
+
+    stx_free(s);
+    stx_free(d);
+    free(big);
+}
+
+// Up to 7 bytes, dims live in the flags byte
+#define TINY_MAX 7
+
+void tiny()
+{
+    stx_t s = stx_from("ab");
+    assert_props (s, 2, 2, "ab");
+    ASSERT_INT (stx_spc(s), 0);
+
+    stx_t d = stx_dup(s);
+    assert_props (d, 2, 2, "ab");
+    stx_free(d);
+
+    stx_resize (&s, TINY_MAX);
+    assert_props (s, TINY_MAX, 2, "ab");
+    ASSERT_INT (stx_append_strict (s, "cdefg", 5), TINY_MAX);
+    assert_props (s, TINY_MAX, TINY_MAX, "abcdefg");
+    ASSERT_INT (stx_append_strict (s, "h", 1), -(TINY_MAX+1));
+    
+    // promoted
+    ASSERT_INT (stx_append (&s, "h", 1), TINY_MAX+1);
+    ASSERT_STR (s, "abcdefgh");
+    stx_resize (&s, 3);
+    assert_props (s, 3, 3, "abc");
+    stx_reset (s);
+    assert_props (s, 3, 0, "");
+    stx_free(s);
+
+    for (size_t cap = 0; cap <= TINY_MAX+1; ++cap) {
+        s = stx_new(cap);
+        assert_props (s, cap, 0, "");
+        ASSERT_INT (stx_append_fmt (&s, "%s", "0123456789"), 10);
+        ASSERT_STR (s, "0123456789");
+        stx_free(s);
+    }
+
+    // packed tokens stay foreign
+    int cnt;
+    stx_t* list = stx_split_pack ("a|bc|defghijk|", 14, "|", 1, &cnt);
+    ASSERT_INT (cnt, 4);
+    assert_props (list[0], 1, 1, "a");
+    assert_props (list[1], 2, 2, "bc");
+    assert_props (list[2], 8, 8, "defghijk");
+    assert_props (list[3], 0, 0, "");
+    stx_append (&list[1], "d", 1);
+    ASSERT_STR (list[1], "bcd");
+    assert_props (list[0], 1, 1, "a");
+    stx_list_free (list); // frees moved list[1]
+}
+
+// Past 4GB : only a few pages get touched
+void huge()
+{
+#if SIZE_MAX > UINT32_MAX
+    const size_t cap = (size_t)5 << 30;
+    stx_t s = stx_from(foo);
+
+    if (!stx_reserve (&s, cap)) {
+        printf("stx_reserve(%zu) failed.\n", cap); 
+        stx_free(s);
+        return;
+    }
+
+    assert (stx_cap(s) == foolen+cap);
+    ASSERT_STR (s, foo);
+    ASSERT_INT (stx_append (&s, bar, barlen), foobarlen);
+    ASSERT_STR (s, foobar);
+    assert (stx_spc(s) == foolen+cap-foobarlen);
+
+    stx_resize (&s, foolen);
+    assert_props (s, foolen, foolen, foo);
+
+    stx_free(s);
+#endif
+}
+
+void appendv()
+{
+    stx_t s = stx_from(foo);
+    const stx_view parts[] = {{bar, barlen}, {"", 0}, {"\0x", 2}, {w256, 256}};
+    
+    ASSERT_INT (stx_appendv (&s, parts, 0), foolen);
+    ASSERT_INT (stx_appendv (&s, parts, 1), foobarlen);
+    ASSERT_STR (s, foobar);
+    ASSERT_INT (stx_appendv (&s, parts+1, 3), (foobarlen+2+256));
+    assert (!memcmp(s+foobarlen, "\0x", 2));
+    assert (!strcmp(s+foobarlen+2, w256));
+    stx_free(s);
+
+    s = stx_new(0);
+    ASSERT_INT (stx_append_many (&s, foo, "", bar, NULL), foobarlen);
+    assert_props (s, stx_cap(s), foobarlen, foobar);
+    ASSERT_INT (stx_append_many (&s, NULL), foobarlen);
+    stx_reset(s);
+
+    // more parts than a local batch
+    #define MANY_ARGS(x) x,x,x,x,x,x,x,x,x,x
+    ASSERT_INT (stx_append_many (&s, MANY_ARGS(MANY_ARGS(foo)), NULL), (100*foolen));
+    for (int i = 0; i < 100; ++i) assert (!memcmp(s + i*foolen, foo, foolen));
+    #undef MANY_ARGS
+    stx_free(s);
+}
+
+void append_typed()
+{
+    char exp[512];
+    stx_t s = stx_new(0);
+
+    #define TYPED(fun, v, fmt) { \
+        stx_reset(s); \
+        snprintf (exp, sizeof(exp), fmt, v); \
+        ASSERT_INT (fun (&s, v), strlen(exp)); \
+        ASSERT_STR (s, exp); \
+    }
+
+    const long long ints[] = {0, 1, -1, 9, 10, -99, 100, 12345, -987654321, 
+        INT64_MAX, INT64_MIN, INT64_MAX/10, 1000000000000000000};
+    for (size_t i = 0; i < sizeof(ints)/sizeof(ints[0]); ++i) {
+        TYPED (stx_append_int, ints[i], "%lld");
+        TYPED (stx_append_uint, (unsigned long long)ints[i], "%llu");
+        TYPED (stx_append_hex, (unsigned long long)ints[i], "%llx");
+    }
+
+    // fixed
+    #define FIXED(v, prec) { \
+        stx_reset(s); \
+        snprintf (exp, sizeof(exp), "%.*f", prec, v); \
+        stx_append_double (&s, v, prec); \
+        ASSERT_STR (s, exp); \
+    }
+    const double dbls[] = {0, -0.0, 1, -1, 0.5, 0.1, 3.14159, -2.71828, 
+        123456.789, 1e-7, 1e15, -1e18, 1e300, 5e-324};
+    for (size_t i = 0; i < sizeof(dbls)/sizeof(dbls[0]); ++i) {
+        FIXED (dbls[i], 0);
+        FIXED (dbls[i], 3);
+        FIXED (dbls[i], 6);
+        FIXED (dbls[i], 20);
+    }
+
+    // random values and exact ties against printf
+    srand(1);
+    for (int i = 0; i < 20000; ++i) {
+        const double v = (i & 1) ? (rand() - RAND_MAX/2) / (double)(1 + rand() % 100000)
+                                 : (rand() % 100000) / 64.0;
+        FIXED (v, i % 10);
+        stx_reset(s);
+        stx_append_double (&s, v, -1);
+        assert (strtod(s, NULL) == v);
+    }
+
+    // shortest round-trip
+    const double rt[] = {0, -0.0, 1, 0.1, 0.3, -2.5, 1.0/3, 123.456, 1e-7, 
+        1e16, 1e300, 5e-324, 0.1+0.2, 9007199254740993.0, INFINITY, -INFINITY};
+    for (size_t i = 0; i < sizeof(rt)/sizeof(rt[0]); ++i) {
+        stx_reset(s);
+        stx_append_double (&s, rt[i], -1);
+        assert (strtod(s, NULL) == rt[i] && signbit(strtod(s, NULL)) == signbit(rt[i]));
+        snprintf (exp, sizeof(exp), "%.17g", rt[i]);
+        assert (stx_len(s) <= strlen(exp) || strchr(s, '.'));
+    }
+    stx_reset(s);
+    stx_append_double (&s, 0.1, -1);
+    ASSERT_STR (s, "0.1");
+    stx_reset(s);
+    stx_append_double (&s, -2.5, -1);
+    ASSERT_STR (s, "-2.5");
+    stx_reset(s);
+    stx_append_double (&s, NAN, -1);
+    ASSERT_STR (s, "nan");
+
+    // appended, not replaced
+    stx_reset(s);
+    stx_append (&s, foo, foolen);
+    stx_append_int (&s, -42);
+    stx_append_hex (&s, 0xbeef);
+    stx_append_double (&s, 1.5, 2);
+    ASSERT_STR (s, "foo-42beef1.50");
+
+    stx_free(s);
+    #undef TYPED
+    #undef FIXED
+}
+
+void append_cfmt()
+{
+    char exp[8192];
+    stx_t s = stx_new(0);
+
+    #define CFMT(fmt, ...) { \
+        stx_fmt* f = stx_fmt_compile (fmt); \
+        assert (f); \
+        stx_reset(s); \
+        stx_append (&s, foo, foolen); \
+        const int explen = snprintf (exp, sizeof(exp), FOO fmt, __VA_ARGS__); \
+        ASSERT_INT (stx_append_cfmt (&s, f, __VA_ARGS__), explen); \
+        ASSERT_STR (s, exp); \
+        stx_fmt_free(f); \
+    }
+
+    CFMT ("%s \t (+%d) %s\n", "alice", 42, "hello");
+    CFMT ("%d%%%d", -1, 100);
+    CFMT ("%i|%u|%x|%c", INT32_MIN, UINT32_MAX, 0xbeefu, 'z');
+    CFMT ("%ld %lu %lx", -123456789012L, 123456789012UL, 0xdeadbeefcafeUL);
+    CFMT ("%lld %llu %zu %zd", LLONG_MIN, ULLONG_MAX, (size_t)SIZE_MAX, (size_t)42);
+    CFMT ("%f %.0f %.3f %.17f", 3.14159, 2.5, -0.0005, 0.1);
+    CFMT ("%.3f %f", 1e300, -INFINITY);
+    CFMT ("%.20f", 1.0/3);
+    CFMT ("%5d|%-5d|%05d|%+d", 42, 42, 42, 42);
+    CFMT ("%8s|%-8s|%.2s", foo, bar, "abcdef");
+    CFMT ("%e %g %G %a", 12345.678, 0.0001, 1e20, 1.5);
+    CFMT ("%X %o %#x %.4x", 0xabcu, 8u, 255u, 7u);
+    CFMT ("%hhd %hd %hu", 300, 70000, 70000);
+    CFMT ("%p", (void*)s);
+    CFMT ("%s", w4096);
+    CFMT ("no spec%s", "");
+
+    assert (!stx_fmt_compile ("%n"));
+    assert (!stx_fmt_compile ("%*d"));
+    assert (!stx_fmt_compile ("%.*f"));
+    assert (!stx_fmt_compile ("%ls"));
+    assert (!stx_fmt_compile ("%Lf"));
+    assert (!stx_fmt_compile ("%jd"));
+    assert (!stx_fmt_compile ("trailing %"));
+
+    // reusable
+    stx_fmt* f = stx_fmt_compile ("%d,");
+    stx_reset(s);
+    for (int i = 0; i < 1000; ++i) stx_append_cfmt (&s, f, i);
+    int i = 0;
+    for (const char* c = s; *c; ++i) {
+        ASSERT_INT (atoi(c), i);
+        c = strchr(c, ',') + 1;
+    }
+    ASSERT_INT (i, 1000);
+    stx_fmt_free(f);
+
+    stx_free(s);
+    #undef CFMT
+}
+
+// allocator may give more than asked
+#define SLACK_MAX 32
+
+// Real size of a block of `size` bytes, as the library sees it
+static size_t usable (const char* block, const size_t size)
+{
+    #ifdef STX_POOL
+    if (size <= 3+255+1) return (size + 15) & ~(size_t)15; // size class
+    #endif
+    #ifdef __GLIBC__
+    (void)size;
+    return malloc_usable_size ((void*)block);
+    #else
+    (void)block;
+    return size;
+    #endif
+}
+
+void growth()
+{
+    #define GROW(policy, len, expcap) { \
+        stx_set_growth(policy); \
+        stx_t s = stx_new(0); \
+        stx_append (&s, w4096, len); \
+        assert (stx_cap(s) >= expcap && stx_cap(s) < expcap + SLACK_MAX); \
+        ASSERT_INT (stx_len(s), len); \
+        assert (!memcmp(s, w4096, len)); \
+        stx_free(s); \
+    }
+
+    GROW (STX_GROW_DOUBLE, 10, 20);
+    GROW (STX_GROW_HALF, 10, 15);
+    GROW (STX_GROW_HALF, 1000, 1500);
+    GROW (STX_GROW_CAPPED, 1000, 2000);
+    // block rounded to 16, 512, page multiple
+    GROW (STX_GROW_ROUND, 10, 16-3-1);
+    GROW (STX_GROW_ROUND, 300, 512-5-1);
+    GROW (STX_GROW_ROUND, 4096, 8192-5-1);
+    
+    stx_set_growth (STX_GROW_DOUBLE);
+    #undef GROW
+
+    // the cap is what the block really holds : filling it doesn't move
+    #define SLACK(len, dataoff, expcap) { \
+        stx_t s = stx_new(0); \
+        stx_append (&s, w4096, len); \
+        const size_t asked = dataoff + 2*len + 1; \
+        ASSERT_INT (stx_cap(s), (expcap + usable(s - dataoff, asked) - asked)); \
+        const char* before = s; \
+        const size_t cap = stx_cap(s); \
+        stx_append (&s, w4096, cap - len); \
+        assert (s == before && stx_cap(s) == cap); \
+        stx_free(s); \
+    }
+
+    SLACK (10, 3, 20);      // TYPE1
+    SLACK (1000, 5, 2000);  // TYPE2
+    #undef SLACK
+}
+
+void reserve()
+{
+    stx_t s = stx_from(foo);
+    stx_reserve (&s, 10);
+    assert_props (s, foolen+10, foolen, foo);
+    stx_reserve (&s, 5); // nop
+    assert_props (s, foolen+10, foolen, foo);
+    stx_reserve (&s, 1024);
+    assert_props (s, foolen+1024, foolen, foo);
+    stx_free(s);
+}
+
+
 void append_strict()
 {
     #define INIT(cap, src, len,   exprc, explen, expstr) { \
@@ -354,6 +721,47 @@ void append_fmt()
 
     MORE (foobarlen, "%s", bar, foobarlen, foobarlen, foobar);
     #undef MORE
+
+    // arguments pointing into dst : in place, moved, and past the local buffer
+    stx_t s = stx_new(100);
+    stx_append (&s, "abc", 3);
+    stx_append_fmt (&s, "-%s-%s", s, s);
+    ASSERT_STR (s, "abc-abc-abc");
+
+    stx_t t = stx_from("abc");
+    stx_append_fmt (&t, "%s-%s", t, t);
+    ASSERT_STR (t, "abcabc-abc");
+
+    stx_t u = stx_from(w4096);
+    stx_append_fmt (&u, "%s", u); // new block
+    ASSERT_INT (stx_len(u), 8192);
+    assert (!memcmp(u, w4096, 4096) && !memcmp(u+4096, w4096, 4096));
+
+    stx_t v = stx_new(10000);
+    stx_append (&v, w4096, 4096);
+    const char* before = v;
+    stx_append_fmt (&v, "%s", v); // fits
+    assert (v == before);
+    ASSERT_INT (stx_len(v), 8192);
+    assert (!memcmp(v, w4096, 4096) && !memcmp(v+4096, w4096, 4096));
+    stx_free(v);
+
+    // the new block keeps prefix slots
+    v = stx_from(foo);
+    stx_hash_enable (&v);
+    stx_share_enable (&v);
+    stx_hash (v);
+    stx_append_fmt (&v, "%s", w4096);
+    ASSERT_INT (stx_refs(v), 1);
+    ASSERT_INT (stx_len(v), (foolen+4096));
+    stx_t ref = stx_from_len (v, stx_len(v));
+    assert (stx_hash(v) == stx_hash(ref));
+    stx_free(ref);
+    stx_free(v);
+
+    stx_free(s);
+    stx_free(t);
+    stx_free(u);
 }
 
 
@@ -447,7 +855,7 @@ void split_pat (splitter fun, const char* word, const char* sep, size_t n)
 }
 
 #define LIST_LOCAL_MAX (STX_LOCAL_MEM/sizeof(stx_t))
-#define LIST_POOL_MAX (STX_LIST_POOL_MEM/sizeof(stx_t))
+#define LIST_BIG (1<<21)
 
 void u_split(splitter fun)
 {
@@ -463,14 +871,299 @@ void u_split(splitter fun)
     split_pat (fun, FOO, SEP, LIST_LOCAL_MAX);
     split_pat (fun, FOO, SEP, LIST_LOCAL_MAX+1);
 
-    split_pat (fun, FOO, SEP, LIST_POOL_MAX-1);
-    split_pat (fun, FOO, SEP, LIST_POOL_MAX);
-    split_pat (fun, FOO, SEP, LIST_POOL_MAX+1);
+    split_pat (fun, FOO, SEP, LIST_BIG-1);
+    split_pat (fun, FOO, SEP, LIST_BIG);
+    split_pat (fun, FOO, SEP, LIST_BIG+1);
 
     // split_pat (fun, FOO, SEP, 20000000);
 }
 
 void split() {u_split(stx_split_len);}
+void split_pack() {u_split(stx_split_pack);}
+
+// packed parts must survive growth and free
+void split_pack_grow()
+{
+    int cnt = 0;
+    stx_t* list = stx_split_pack (FOO SEP BAR, 7, SEP, 1, &cnt);
+    ASSERT_INT (cnt, 2);
+
+    stx_t d = stx_dup(list[1]);
+    stx_free(list[1]); // nop
+    assert_props (list[1], barlen, barlen, bar);
+    assert_props (d, barlen, barlen, bar);
+    stx_free(d);
+
+    stx_append (&list[0], w256, 256); // moved to own block
+    ASSERT_INT (stx_len(list[0]), foolen+256);
+    assert (!strncmp(list[0], FOO W256, foolen+256));
+
+    stx_resize (&list[1], 1); // moved to own block
+    assert_props (list[1], 1, 1, "b");
+
+    stx_list_free(list);
+}
+
+// concurrent splits must not share scratch memory
+#define MT_THREADS 8
+#define MT_PARTS (LIST_LOCAL_MAX*64)
+#define MT_ROUNDS 10
+
+static void* split_worker (void* arg)
+{
+    const char* word = arg;
+    const size_t wordlen = strlen(word);
+    const char* pat = str_cat(word,SEP);
+    const char* txt = str_repeat(pat,MT_PARTS);
+    const size_t txtlen = strlen(txt);
+    splitter funs[] = {stx_split_len, stx_split_pack};
+
+    for (int r = 0; r < MT_ROUNDS; ++r) {
+        int cnt = 0;
+        stx_t* list = funs[r%2](txt, txtlen, SEP, 1, &cnt);
+        ASSERT_INT (cnt, MT_PARTS+1);
+        for (int i = 0; i < cnt-1; ++i) {
+            assert_props (list[i], wordlen, wordlen, word);
+        }
+        stx_list_free(list);
+    }
+
+    free((char*)pat);
+    free((char*)txt);
+    return NULL;
+}
+
+void split_threads()
+{
+    const char* words[MT_THREADS] = 
+        {"a", "bb", "ccc", "dddd", "eeeee", "ffffff", "ggggggg", "hhhhhhhh"};
+    pthread_t threads[MT_THREADS];
+
+    for (int i = 0; i < MT_THREADS; ++i)
+        pthread_create (&threads[i], NULL, split_worker, (void*)words[i]);
+    for (int i = 0; i < MT_THREADS; ++i)
+        pthread_join (threads[i], NULL);
+}
+
+//==============================================================================
+
+void split_view()
+{
+    const char* src = FOO SEP SEP BAR SEP FOO;
+    int cnt = 0;
+    stx_view* list = stx_split_view (src, strlen(src), SEP, 1, &cnt);
+    
+    ASSERT_INT (cnt, 4);
+    assert (list[0].data == src && list[0].len == foolen);
+    ASSERT_INT (list[1].len, 0);
+    assert (list[2].data == src+5 && list[2].len == barlen);
+    assert (!list[4].data);
+    
+    assert (stx_view_equal(list[0], list[3]));
+    assert (!stx_view_equal(list[0], list[2]));
+    ASSERT_INT (stx_view_find(list[2], "ar", 2), 1);
+    ASSERT_INT (stx_view_find(list[2], "ra", 2), -1);
+    ASSERT_INT (stx_view_find(list[2], "bar|", 4), -1); // bounded
+    ASSERT_INT (stx_view_find(list[2], "", 0), 0);
+
+    stx_t s = stx_from_view(list[2]);
+    assert_props (s, barlen, barlen, bar);
+    assert (stx_view_equal(stx_view_of(s), list[2]));
+    stx_free(s);
+    free(list);
+
+    // many parts
+    const char* txt = str_repeat(FOO SEP, LIST_LOCAL_MAX*4);
+    list = stx_split_view (txt, strlen(txt), SEP, 1, &cnt);
+    ASSERT_INT (cnt, LIST_LOCAL_MAX*4+1);
+    for (int i = 0; i < cnt-1; ++i)
+        assert (list[i].data == txt+4*i && list[i].len == foolen);
+    free(list);
+    free((char*)txt);
+}
+
+void split_iter()
+{
+    const char* src = FOO SEP SEP BAR;
+    stx_iter it;
+    stx_view part;
+    int cnt = 0;
+
+    stx_split_iter (&it, src, strlen(src), SEP, 1);
+    while (stx_split_next(&it, &part)) {
+        const char* exp = (char*[]){FOO, "", BAR}[cnt++];
+        ASSERT_INT (part.len, strlen(exp));
+        assert (!memcmp(part.data, exp, part.len));
+    }
+    ASSERT_INT (cnt, 3);
+    assert (!stx_split_next(&it, &part));
+
+    // trailing sep yields empty last part
+    stx_split_iter (&it, FOO SEP, 4, SEP, 1);
+    assert (stx_split_next(&it, &part) && part.len == foolen);
+    assert (stx_split_next(&it, &part) && part.len == 0);
+    assert (!stx_split_next(&it, &part));
+
+    // bounded by srclen
+    stx_split_iter (&it, FOO SEP BAR, foolen, SEP, 1);
+    assert (stx_split_next(&it, &part) && part.len == foolen);
+    assert (!stx_split_next(&it, &part));
+
+    // no sep
+    stx_split_iter (&it, foo, foolen, "", 0);
+    assert (!stx_split_next(&it, &part));
+}
+
+// splitters must agree with the iterator on any separator layout
+void split_random()
+{
+    char src[1000];
+    srand(1);
+
+    for (int round = 0; round < 200; ++round) {
+        const int len = rand() % sizeof(src);
+        const int dens = 1 + rand() % 8;
+        for (int i = 0; i < len; ++i) 
+            src[i] = (rand() % dens) ? 'a' + rand()%3 : '|';
+        src[len] = 0;
+
+        int cnt = 0;
+        stx_t* list = stx_split_len (src, len, SEP, 1, &cnt);
+        stx_t* pack = stx_split_pack (src, len, SEP, 1, &cnt);
+        stx_iter it;
+        stx_view part;
+        int i = 0;
+
+        stx_split_iter (&it, src, len, SEP, 1);
+        while (stx_split_next(&it, &part)) {
+            assert (stx_view_equal(part, stx_view_of(list[i])));
+            assert (stx_view_equal(part, stx_view_of(pack[i])));
+            ++i;
+        }
+        ASSERT_INT (i, cnt);
+
+        stx_list_free(list);
+        stx_list_free(pack);
+    }
+}
+
+// Forced parallel scans against the sequential iterator.
+// Odd chunk size : runs of '-' put separators astride chunk edges.
+#define PAR_LEN (32*65537)
+
+static void u_split_parallel (const char* src, const char* sep)
+{
+    const size_t seplen = strlen(sep);
+    int cnt = 0, pcnt = 0, vcnt = 0;
+
+    stx_set_parallel (4, 0);
+    stx_t* list = stx_split_len (src, PAR_LEN, sep, seplen, &cnt);
+    stx_t* pack = stx_split_pack (src, PAR_LEN, sep, seplen, &pcnt);
+    stx_view* views = stx_split_view (src, PAR_LEN, sep, seplen, &vcnt);
+    stx_set_parallel (0, STX_PAR_MIN);
+
+    ASSERT_INT (pcnt, cnt);
+    ASSERT_INT (vcnt, cnt);
+
+    stx_iter it;
+    stx_view part;
+    int i = 0;
+
+    stx_split_iter (&it, src, PAR_LEN, sep, seplen);
+    while (stx_split_next(&it, &part)) {
+        assert (i < cnt);
+        assert (stx_view_equal(part, stx_view_of(list[i])));
+        assert (stx_view_equal(part, stx_view_of(pack[i])));
+        assert (stx_view_equal(part, views[i]));
+        ++i;
+    }
+    ASSERT_INT (i, cnt);
+
+    stx_list_free(list);
+    stx_list_free(pack);
+    free(views);
+}
+
+void split_parallel()
+{
+    char* src = malloc(PAR_LEN);
+    srand(3);
+
+    memset (src, '-', PAR_LEN);
+    u_split_parallel (src, "-");
+    u_split_parallel (src, "--");
+    u_split_parallel (src, "---");
+
+    for (int i = 0; i < PAR_LEN; ++i) 
+        src[i] = (rand() % 4) ? '-' : 'a' + rand()%2;
+    u_split_parallel (src, "--");
+    u_split_parallel (src, "-a-");
+    u_split_parallel (src, "|"); // none
+
+    for (int i = 0; i < PAR_LEN; ++i) 
+        src[i] = "ab"[rand() % 2];
+    u_split_parallel (src, "a");
+    u_split_parallel (src, "abab");
+    u_split_parallel (src, "aabaa");
+
+    free(src);
+}
+
+// embedded NULs, no terminator : bounded by srclen
+void split_binary()
+{
+    const char bin[] = {'a','\0','|','|','b','\0','|','|','c'};
+    const size_t binlen = sizeof(bin);
+    char* src = malloc(binlen); // no terminator
+    memcpy (src, bin, binlen);
+
+    splitter funs[] = {stx_split_len, stx_split_pack};
+    
+    for (int f = 0; f < 2; ++f) {
+        int cnt = 0;
+        stx_t* list = funs[f](src, binlen, "||", 2, &cnt);
+        ASSERT_INT (cnt, 3);
+        ASSERT_INT (stx_len(list[0]), 2);
+        assert (!memcmp(list[0], "a", 2));
+        ASSERT_INT (stx_len(list[1]), 2);
+        assert (!memcmp(list[1], "b", 2));
+        ASSERT_INT (stx_len(list[2]), 1);
+        stx_list_free(list);
+
+        list = funs[f](src, binlen, "\0|", 2, &cnt);
+        ASSERT_INT (cnt, 3);
+        stx_list_free(list);
+
+        // sep straddling srclen is not matched
+        list = funs[f](src, 3, "||", 2, &cnt);
+        ASSERT_INT (cnt, 1);
+        ASSERT_INT (stx_len(list[0]), 3);
+        stx_list_free(list);
+    }
+
+    // long sep over a long, unterminated buffer (SIMD path)
+    const char* pat = str_repeat(FOO "<=>", 100);
+    const size_t patlen = strlen(pat);
+    char* buf = malloc(patlen);
+    memcpy (buf, pat, patlen);
+    buf[7] = 0; // "f\0o"
+
+    int cnt = 0;
+    stx_view* views = stx_split_view (buf, patlen, "<=>", 3, &cnt);
+    ASSERT_INT (cnt, 101);
+    ASSERT_INT (views[3].len, foolen);
+    ASSERT_INT (views[100].len, 0);
+    free(views);
+
+    ASSERT_INT (stx_view_find((stx_view){buf, patlen}, FOO "<=>" FOO "<", 8), 12);
+    ASSERT_INT (stx_view_find((stx_view){buf, patlen}, "o<=>f", 5), 2);
+    ASSERT_INT (stx_view_find((stx_view){buf+4, patlen-4}, "<=>", 3), 5);
+    ASSERT_INT (stx_view_find((stx_view){buf+patlen-6, 5}, "<=>", 3), -1);
+
+    free(buf);
+    free((char*)pat);
+    free(src);
+}
 
 //==============================================================================
 
@@ -493,6 +1186,242 @@ void join()
     u_splitjoin (FOO SEP FOO SEP, SEP, 1);
     u_splitjoin (FOO SEP SEP FOO, SEP, 1);
     u_splitjoin (FOO BAR FOO, BAR, barlen);
+
+    // packed
+    int count;
+    stx_t* list = stx_split_pack (FOO SEP W256 SEP, 3+1+256+1, SEP, 1, &count);
+    stx_t joined = stx_join_len (list, count, SEP, 1);
+    ASSERT_STR (joined, FOO SEP W256 SEP);
+    assert (stx_equal(list[1], list[1]));
+    stx_free(joined);
+    stx_list_free(list);
+}
+
+// forced parallel, same output as one thread
+void join_parallel() 
+{ 
+    const char* seps[] = {"", SEP, "<->"};
+    const int counts[] = {1, 2, 63, 1000, 20000};
+    srand(7);
+
+    for (int c = 0; c < 5; ++c) {
+
+        const int count = counts[c];
+        stx_t* list = malloc (count * sizeof(stx_t));
+        for (int i = 0; i < count; ++i) 
+            list[i] = stx_from_len (w4096 + rand()%64, rand()%300); // some empty
+
+        for (int s = 0; s < 3; ++s) {
+            const size_t seplen = strlen(seps[s]);
+            stx_set_parallel (1, 0);
+            stx_t ref = stx_join_len (list, count, seps[s], seplen);
+            stx_set_parallel (4, 0);
+            stx_t par = stx_join_len (list, count, seps[s], seplen);
+            assert (stx_equal(par, ref));
+            ASSERT_INT (strlen(par), stx_len(par));
+            stx_free(ref);
+            stx_free(par);
+        }
+
+        for (int i = 0; i < count; ++i) stx_free(list[i]);
+        free(list);
+    }
+
+    stx_set_parallel (0, STX_PAR_MIN);
+}
+
+//==============================================================================
+
+void arena()
+{
+    stx_arena* a = stx_arena_create(1024);
+
+    stx_t s = stx_arena_new(a, 2);
+    assert_props (s, 2, 0, "");
+    stx_free(s); // nop
+
+    // last block : grows in place
+    const char* before = s;
+    stx_arena_append (a, &s, foo, foolen);
+    stx_arena_append (a, &s, bar, barlen);
+    assert (s == before);
+    ASSERT_STR (s, foobar);
+    ASSERT_INT (stx_len(s), foobarlen);
+
+    // not last anymore : moves within arena
+    stx_t f = stx_arena_from_len(a, foo, foolen);
+    stx_arena_append (a, &s, w256, 256);
+    assert (s != before);
+    assert (!strcmp(s, FOO BAR W256));
+    ASSERT_INT (stx_len(s), foobarlen+256);
+
+    // bigger than a chunk
+    stx_arena_append (a, &s, w4096, 4096);
+    ASSERT_INT (stx_len(s), foobarlen+256+4096);
+    assert (!strcmp(s, FOO BAR W256 W4096));
+    assert_props (f, foolen, foolen, foo);
+
+    stx_t d = stx_arena_dup(a, f);
+    assert_props (d, foolen, foolen, foo);
+
+    int cnt = 0;
+    stx_t* list = stx_arena_split_len(a, FOO SEP BAR SEP W256, 3+1+3+1+256, SEP, 1, &cnt);
+    ASSERT_INT (cnt, 3);
+    assert_props (list[2], 256, 256, w256);
+    stx_t joined = stx_arena_join_len(a, list, cnt, SEP, 1);
+    ASSERT_STR (joined, FOO SEP BAR SEP W256);
+
+    // escape to heap with plain API
+    stx_append (&d, bar, barlen);
+    ASSERT_STR (d, foobar);
+    stx_free(d);
+
+    stx_arena_reset(a);
+    s = stx_arena_from_len(a, bar, barlen);
+    assert_props (s, barlen, barlen, bar);
+
+    stx_arena_destroy(a);
+}
+
+void intern()
+{
+    stx_interns* t = stx_interns_create(0);
+
+    stx_t a = stx_intern (t, foo, foolen);
+    stx_t b = stx_intern (t, bar, barlen);
+    assert_props (a, foolen, foolen, foo);
+    assert (a != b);
+    assert (stx_intern (t, foo, foolen) == a);
+    assert (stx_intern (t, "", 0) == stx_intern (t, "", 0));
+    stx_free(a); // nop
+    ASSERT_INT (stx_interns_count(t), 3);
+
+    // many, past table growth
+    char key[16];
+    stx_t keys[5000];
+    for (int i = 0; i < 5000; ++i) {
+        snprintf (key, sizeof(key), "k%d", i);
+        keys[i] = stx_intern (t, key, strlen(key));
+    }
+    for (int i = 0; i < 5000; ++i) {
+        snprintf (key, sizeof(key), "k%d", i);
+        assert (stx_intern (t, key, strlen(key)) == keys[i]);
+        ASSERT_STR (keys[i], key);
+    }
+    ASSERT_INT (stx_interns_count(t), 5003);
+
+    // bulk, both split flavors
+    const char* src = FOO SEP BAR SEP FOO SEP W256 SEP BAR;
+    splitter funs[] = {stx_split_len, stx_split_pack};
+    for (int f = 0; f < 2; ++f) {
+        int cnt = 0;
+        stx_t* list = funs[f](src, strlen(src), SEP, 1, &cnt);
+        ASSERT_INT (cnt, 5);
+        assert (stx_intern_list (t, list, cnt));
+        assert (list[0] == a && list[2] == a && list[1] == b && list[4] == b);
+        assert_props (list[3], 256, 256, w256);
+        stx_list_free(list);
+    }
+    ASSERT_INT (stx_interns_count(t), 5004);
+
+    // read-only : in place refuses, by pointer copies
+    stx_t p = stx_intern (t, " foo ", 5);
+    stx_trim (p);
+    stx_ltrim (p);
+    stx_trim_chars (p, " ", STX_BOTH);
+    stx_reset (p);
+    stx_adjust (p);
+    ASSERT_INT (stx_append_strict (p, "", 0), 0);
+    ASSERT_INT (stx_append_fmt_strict (p, "%s", ""), 0);
+    ASSERT_STR (p, " foo ");
+    assert (stx_intern (t, " foo ", 5) == p);
+    
+    stx_t q = p;
+    stx_append (&q, "", 0);
+    assert (q != p);
+    stx_trim (q);
+    ASSERT_STR (q, foo);
+    ASSERT_STR (p, " foo ");
+    stx_free(q);
+
+    q = p;
+    assert (stx_resize (&q, 2));
+    assert (q != p);
+    ASSERT_STR (q, " f");
+    ASSERT_STR (p, " foo ");
+    stx_free(q);
+
+    stx_interns_destroy(t);
+}
+
+#define INTERN_KEYS 3000
+
+typedef struct {
+    stx_interns* t;
+    int shift;
+    stx_t got[INTERN_KEYS];
+} InternJob;
+
+static void* intern_worker (void* arg)
+{
+    InternJob* job = arg;
+    char key[16];
+    // each thread starts elsewhere, half by bulk
+    for (int n = 0; n < INTERN_KEYS; ++n) {
+        const int i = (n + job->shift) % INTERN_KEYS;
+        snprintf (key, sizeof(key), "key%d", i);
+        if (i % 2) {
+            job->got[i] = stx_intern (job->t, key, strlen(key));
+        } else {
+            stx_t part = stx_from(key);
+            assert (stx_intern_list (job->t, &part, 1));
+            job->got[i] = part;
+        }
+    }
+    return NULL;
+}
+
+void intern_threads()
+{
+    stx_interns* t = stx_interns_create(1);
+    static InternJob jobs[MT_THREADS];
+    pthread_t threads[MT_THREADS];
+
+    for (int i = 0; i < MT_THREADS; ++i) {
+        jobs[i].t = t;
+        jobs[i].shift = i * INTERN_KEYS / MT_THREADS;
+        pthread_create (&threads[i], NULL, intern_worker, &jobs[i]);
+    }
+    for (int i = 0; i < MT_THREADS; ++i)
+        pthread_join (threads[i], NULL);
+
+    ASSERT_INT (stx_interns_count(t), INTERN_KEYS);
+    for (int i = 1; i < MT_THREADS; ++i)
+        assert (!memcmp (jobs[i].got, jobs[0].got, sizeof(jobs[0].got)));
+
+    stx_interns_destroy(t);
+}
+
+// block recycling across size classes (STX_POOL)
+void pool()
+{
+    stx_t list[64];
+
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 64; ++i) {
+            list[i] = stx_from_len (w256, i*4);
+            stx_append (&list[i], foo, foolen);
+        }
+        for (int i = 0; i < 64; i += 2) {
+            stx_resize (&list[i], i);
+            ASSERT_INT (stx_len(list[i]), min(i, i*4+3));
+            assert (!memcmp(list[i], w256, stx_len(list[i])));
+        }
+        for (int i = 0; i < 64; ++i) 
+            stx_free(list[i]);
+    }
+
+    stx_pool_drain();
 }
 
 //==============================================================================
@@ -536,6 +1465,243 @@ void equal()
     stx_free(b);    
 }
 
+// hashed s has the hash of a fresh copy
+#define ASSERT_HASH(s) { \
+    stx_t ref = stx_from_len(s, stx_len(s)); \
+    assert (stx_hash(s) == stx_hash(ref)); \
+    stx_free(ref); \
+}
+
+void hash()
+{
+    stx_t a = stx_from(foo);
+    const uint64_t h = stx_hash(a);
+    assert (h && h == stx_hash(a));
+
+    // tiny moves to a head with room for the flag
+    assert (stx_hash_enable(&a));
+    assert (stx_hash_enable(&a));
+    assert_props (a, foolen, foolen, foo);
+    assert (stx_hash(a) == h);
+
+    // every mutator drops the cached value
+    stx_append (&a, bar, barlen);
+    ASSERT_HASH(a);
+    stx_append_int (&a, 42);
+    ASSERT_HASH(a);
+    stx_append_fmt (&a, " %s ", foo);
+    ASSERT_HASH(a);
+    stx_append_many (&a, foo, bar, NULL);
+    ASSERT_HASH(a);
+    stx_append_strict (a, "", 0);
+    ASSERT_HASH(a);
+    stx_trim (a);
+    ASSERT_HASH(a);
+    stx_resize (&a, 4);
+    ASSERT_HASH(a);
+    ASSERT_STR (a, "foob");
+    stx_resize (&a, 2);
+    ASSERT_HASH(a);
+    ((char*)a)[1] = 0;
+    stx_adjust (a);
+    ASSERT_HASH(a);
+    stx_reset (a);
+    ASSERT_HASH(a);
+
+    // slot kept through head widening
+    stx_append (&a, w4096, 300);
+    ASSERT_HASH(a);
+    for (int i = 0; i < 20; ++i) stx_append (&a, w4096, 4096);
+    ASSERT_HASH(a);
+    assert (stx_reserve (&a, 100000));
+    ASSERT_HASH(a);
+    assert (!memcmp (a, w4096, 300));
+    stx_free(a);
+
+    // fast rejection, same length
+    stx_t b = stx_from("foobar");
+    stx_t c = stx_from("foobaz");
+    stx_t d = stx_from("foobar");
+    stx_hash_enable(&b);
+    stx_hash_enable(&c);
+    stx_hash_enable(&d);
+    stx_hash(b); stx_hash(c); stx_hash(d);
+    assert (!stx_equal(b, c));
+    assert (stx_equal(b, d));
+    stx_append (&d, "", 0); // slot empty
+    assert (stx_equal(b, d));
+    stx_free(b);
+    stx_free(c);
+    stx_free(d);
+
+    // foreign moves to the heap
+    stx_arena* ar = stx_arena_create(0);
+    stx_t f = stx_arena_from_len (ar, foobar, foobarlen);
+    const uint64_t hf = stx_hash(f);
+    assert (stx_hash_enable(&f));
+    stx_arena_destroy(ar);
+    assert (stx_hash(f) == hf);
+    ASSERT_STR (f, foobar);
+    stx_free(f);
+
+    // distinct keys of 4 to 64 bytes, no collision expected
+    uint64_t seen[1000];
+    for (int i = 0; i < 1000; ++i) {
+        char buf[64];
+        const int len = 4 + i % 61;
+        memset (buf, 'x', len);
+        memcpy (buf, &i, sizeof(i));
+        stx_t s = stx_from_len (buf, len);
+        seen[i] = stx_hash(s);
+        for (int j = 0; j < i; ++j) assert (seen[j] != seen[i]);
+        stx_free(s);
+    }
+}
+
+void share()
+{
+    stx_t s = stx_from(foo);
+    assert (stx_share_enable(&s));
+    assert (stx_share_enable(&s));
+    assert_props (s, foolen, foolen, foo);
+    ASSERT_INT (stx_refs(s), 1);
+
+    // dup is a reference
+    stx_t d = stx_dup(s);
+    assert (d == s);
+    ASSERT_INT (stx_refs(s), 2);
+
+    // copy on write
+    stx_append (&d, bar, barlen);
+    assert (d != s);
+    ASSERT_STR (d, foobar);
+    assert_props (s, foolen, foolen, foo);
+    ASSERT_INT (stx_refs(s), 1);
+    ASSERT_INT (stx_refs(d), 1);
+    stx_free(d);
+
+    // each mutator
+    #define COW(call, exp) { \
+        stx_t c = stx_dup(s); \
+        call; \
+        assert (c != s); \
+        ASSERT_STR (c, exp); \
+        ASSERT_STR (s, foo); \
+        ASSERT_INT (stx_refs(s), 1); \
+        stx_free(c); \
+    }
+    COW (stx_appendv (&c, &(stx_view){bar, barlen}, 1), foobar);
+    COW (stx_append_many (&c, bar, NULL), foobar);
+    COW (stx_append_fmt (&c, "%s", bar), foobar);
+    COW (stx_append_int (&c, 42), "foo42");
+    COW (stx_append_double (&c, 0.5, 1), "foo0.5");
+    COW (stx_resize (&c, 2), "fo");
+    COW (stx_reserve (&c, 100), foo);
+    #undef COW
+
+    // in place ones refuse while shared
+    d = stx_dup(s);
+    ASSERT_INT (stx_append_strict (d, bar, barlen), 0);
+    ASSERT_INT (stx_append_fmt_strict (d, "%s", bar), 0);
+    stx_trim (d);
+    stx_reset (d);
+    assert_props (s, foolen, foolen, foo);
+    stx_free(d);
+
+    // sole reference : in place
+    stx_reserve (&s, 100);
+    const char* before = s;
+    stx_append (&s, bar, barlen);
+    assert (s == before);
+    ASSERT_STR (s, foobar);
+
+    // head widening keeps the count
+    stx_append (&s, w4096, 4096);
+    d = stx_dup(s);
+    ASSERT_INT (stx_refs(d), 2);
+    stx_free(d);
+
+    // so does resizing across head types : TYPE1, TYPE2, TYPE4
+    stx_t r = stx_from(foo);
+    assert (stx_share_enable(&r));
+    const size_t caps[] = {200, 1000, 70000};
+    for (int i = 0; i < 3; ++i) {
+        assert (stx_resize(&r, caps[i]));
+        ASSERT_INT (stx_cap(r), caps[i]);
+        ASSERT_INT (stx_refs(r), 1);
+        const char* before = r;
+        stx_append (&r, bar, barlen); // sole reference : no copy
+        assert (r == before);
+        d = stx_dup(r);
+        ASSERT_INT (stx_refs(r), 2);
+        stx_free(d);
+        ASSERT_INT (stx_refs(r), 1);
+    }
+    stx_free(r);
+
+    // with a cached hash
+    const uint64_t h = stx_hash(s);
+    assert (stx_hash_enable(&s));
+    assert (stx_hash(s) == h);
+    d = stx_dup(s);
+    assert (d == s && stx_equal(d, s));
+    stx_append (&d, foo, foolen);
+    assert (stx_hash(s) == h);
+    ASSERT_HASH(d);
+    stx_free(d);
+
+    // last reference frees
+    d = stx_dup(s);
+    stx_free(s);
+    ASSERT_INT (stx_refs(d), 1);
+    assert (!strncmp(d, foobar, foobarlen));
+    stx_free(d);
+
+    // lists
+    int cnt;
+    stx_t* list = stx_split_len (FOO SEP FOO, 7, SEP, 1, &cnt);
+    stx_share_enable(&list[0]);
+    stx_t keep = stx_dup(list[0]);
+    stx_list_free(list);
+    assert_props (keep, foolen, foolen, foo);
+    stx_free(keep);
+}
+
+#define SHARE_ROUNDS 100000
+
+static void* share_worker (void* arg)
+{
+    stx_t s = arg;
+    const uint64_t h = stx_hash(s); // threads race to fill the slot
+    for (int i = 0; i < SHARE_ROUNDS; ++i) {
+        stx_t d = stx_dup(s);
+        assert (stx_hash(d) == h);
+        if (i % 1000 == 0) {
+            stx_append (&d, foo, foolen);
+            assert (d != s);
+        }
+        stx_free(d);
+    }
+    return NULL;
+}
+
+void share_threads()
+{
+    stx_t s = stx_from(w256);
+    stx_share_enable(&s);
+    stx_hash_enable(&s);
+    pthread_t threads[MT_THREADS];
+
+    for (int i = 0; i < MT_THREADS; ++i)
+        pthread_create (&threads[i], NULL, share_worker, (void*)s);
+    for (int i = 0; i < MT_THREADS; ++i)
+        pthread_join (threads[i], NULL);
+
+    ASSERT_INT (stx_refs(s), 1);
+    assert_props (s, 256, 256, w256);
+    stx_free(s);
+}
+
 #define u_trim(src, expcap, explen) {\
     stx_t s = stx_from(src);\
     stx_trim(s);\
@@ -551,6 +1717,165 @@ void trim()
     u_trim (" foo ", 5, foolen)
 }
 
+#define u_side(fun, src, exp) {\
+    stx_t s = stx_from(src);\
+    const size_t cap = stx_cap(s);\
+    fun;\
+    assert_props(s, cap, strlen(exp), exp);\
+    stx_free(s);\
+}
+
+// Reference : byte loop over the C-locale isspace
+static void naive_trim (char* buf, size_t* len, const char* set, int side)
+{
+    size_t beg = 0, end = *len;
+    if (side & STX_LEFT) while (beg < end && memchr(set, buf[beg], strlen(set))) ++beg;
+    if (side & STX_RIGHT) while (end > beg && memchr(set, buf[end-1], strlen(set))) --end;
+    memmove (buf, buf+beg, end-beg);
+    *len = end-beg;
+}
+
+void trim_sides() 
+{
+    u_side (stx_ltrim(s), " \t\n foo \r\n", "foo \r\n")
+    u_side (stx_rtrim(s), " \t\n foo \r\n", " \t\n foo")
+    u_side (stx_ltrim(s), "   ", "")
+    u_side (stx_rtrim(s), "   ", "")
+    u_side (stx_rtrim(s), "", "")
+    u_side (stx_trim(s), "\v\f foo bar \v\f", "foo bar")
+    u_side (stx_trim(s), "                    foo                    ", "foo")
+    u_side (stx_trim(s), "foo\xa0", "foo\xa0")
+    u_side (stx_trim_chars(s, "-=", STX_BOTH), "=-=foo-=-", "foo")
+    u_side (stx_trim_chars(s, "-=", STX_LEFT), "=-=foo-=-", "foo-=-")
+    u_side (stx_trim_chars(s, "-=", STX_RIGHT), "=-=foo-=-", "=-=foo")
+    u_side (stx_trim_chars(s, "\r\n", STX_RIGHT), " foo\r\n", " foo")
+    u_side (stx_trim_chars(s, "", STX_BOTH), " foo ", " foo ")
+
+    // random runs around the vector width, with inner NULs
+    const char* spaces = " \t\n\v\f\r";
+    const int sides[] = {STX_LEFT, STX_RIGHT, STX_BOTH};
+    char buf[128];
+    srand(24);
+
+    for (int iter = 0; iter < 3000; ++iter) {
+        size_t len = rand() % sizeof(buf);
+        for (size_t i = 0; i < len; ++i) {
+            const int r = rand() % 8;
+            buf[i] = r < 6 ? spaces[r] : r == 6 ? 'x' : 0;
+        }
+        const int side = sides[iter % 3];
+        stx_t s = stx_from_len(buf, len);
+        const size_t cap = stx_cap(s);
+
+        if (side == STX_LEFT) stx_ltrim(s);
+        else if (side == STX_RIGHT) stx_rtrim(s);
+        else stx_trim(s);
+
+        naive_trim (buf, &len, spaces, side);
+        ASSERT_INT (stx_len(s), len);
+        ASSERT_INT (stx_cap(s), cap);
+        ASSERT_INT (memcmp(s, buf, len), 0);
+        ASSERT_INT (s[len], 0);
+        stx_free(s);
+    }
+}
+
+// Reference : every position, non-overlapping after a match
+static size_t naive_find_all (const char* hay, size_t haylen, const char* pat, size_t patlen, size_t* out)
+{
+    size_t n = 0;
+    for (size_t i = 0; patlen && i + patlen <= haylen; ++i)
+        if (!memcmp(hay+i, pat, patlen)) {out[n++] = i; i += patlen-1;}
+    return n;
+}
+
+static long long naive_rfind (const char* hay, size_t haylen, const char* pat, size_t patlen)
+{
+    for (size_t i = haylen-patlen+1; patlen <= haylen && i-- > 0;)
+        if (!memcmp(hay+i, pat, patlen)) return i;
+    return -1;
+}
+
+void find()
+{
+    stx_t s = stx_from_len (FOO "\0" BAR FOO "\0" BAR, 2*(foolen+1+barlen));
+    int cnt = 0;
+
+    ASSERT_INT (stx_find(s, BAR, barlen), (foolen+1));
+    ASSERT_INT (stx_rfind(s, BAR, barlen), (2*foolen+2+barlen));
+    ASSERT_INT (stx_find(s, "\0" BAR, barlen+1), foolen); // past NUL
+    ASSERT_INT (stx_find(s, "baz", 3), -1);
+    ASSERT_INT (stx_rfind(s, "baz", 3), -1);
+    ASSERT_INT (stx_find(s, "", 0), 0);
+    ASSERT_INT (stx_rfind(s, "", 0), stx_len(s));
+    ASSERT_INT (stx_count(s, FOO, foolen), 2);
+    ASSERT_INT (stx_count(s, "", 0), 0);
+
+    size_t* all = stx_find_all (s, "\0", 1, &cnt);
+    ASSERT_INT (cnt, 2);
+    ASSERT_INT (all[0], foolen);
+    ASSERT_INT (all[1], (2*foolen+1+barlen));
+    STX_FREE(all);
+    stx_free(s);
+
+    s = stx_from("aaaaa");
+    ASSERT_INT (stx_count(s, "aa", 2), 2); // non-overlapping
+    ASSERT_INT (stx_rfind(s, "aa", 2), 3);
+    stx_free(s);
+
+    // every position a candidate for the first/last filter
+    char* a = malloc(5000);
+    memset (a, 'a', 5000);
+    char apat[40];
+    memset (apat, 'a', 40);
+    apat[20] = 'b';
+    s = stx_from_len (a, 5000);
+    ASSERT_INT (stx_find(s, apat, 40), -1);
+    ASSERT_INT (stx_rfind(s, apat, 40), -1);
+    memcpy ((char*)s + 4000, apat, 40);
+    memcpy ((char*)s + 1000, apat, 40);
+    ASSERT_INT (stx_find(s, apat, 40), 1000);
+    ASSERT_INT (stx_rfind(s, apat, 40), 4000);
+    ASSERT_INT (stx_count(s, apat, 40), 2);
+    stx_free(s);
+    free(a);
+
+    // random haystacks over a small alphabet : periodic needles,
+    // many near-misses, lengths on both sides of TWOWAY_MIN
+    const char alpha[] = {'a', 'b', 0};
+    // the last ones long enough for the filter to hand over to Two-Way
+    char hay[8000], pat[80];
+    size_t exp[8000];
+    srand(25);
+
+    for (int iter = 0; iter < 4500; ++iter) {
+        const int ab = 2 + (iter & 1); // two or three letters
+        const size_t haylen = rand() % (iter < 4000 ? 400 : sizeof(hay));
+        const size_t patlen = 1 + rand() % sizeof(pat);
+        for (size_t i = 0; i < haylen; ++i) hay[i] = alpha[rand() % ab];
+        for (size_t i = 0; i < patlen; ++i) pat[i] = alpha[rand() % ab];
+
+        // plant the needle, sometimes twice
+        if (patlen <= haylen && iter % 3) {
+            memcpy (hay + rand() % (haylen-patlen+1), pat, patlen);
+            memcpy (hay + rand() % (haylen-patlen+1), pat, patlen);
+        }
+
+        s = stx_from_len (hay, haylen);
+        const size_t n = naive_find_all (hay, haylen, pat, patlen, exp);
+
+        ASSERT_INT (stx_find(s, pat, patlen), (n ? (long long)exp[0] : -1));
+        ASSERT_INT (stx_rfind(s, pat, patlen), naive_rfind(hay, haylen, pat, patlen));
+        ASSERT_INT (stx_count(s, pat, patlen), n);
+
+        all = stx_find_all (s, pat, patlen, &cnt);
+        ASSERT_INT (cnt, n);
+        ASSERT_INT (memcmp(all, exp, n * sizeof(*exp)), 0);
+        STX_FREE(all);
+        stx_free(s);
+    }
+}
+
 //==============================================================================
 
 void story()
@@ -587,16 +1912,42 @@ int main()
     run (from_len);
     run (dup);
     run (join);
+    run (join_parallel);
     run (split);
+    run (split_pack);
+    run (split_pack_grow);
+    run (split_threads);
+    run (split_view);
+    run (split_iter);
+    run (split_random);
+    run (split_binary);
+    run (split_parallel);
+    run (arena);
+    run (pool);
+    run (intern);
+    run (intern_threads);
     run (append);
+    run (appendv);
+    run (append_typed);
+    run (append_cfmt);
     run (append_strict);
+    run (types);
+    run (tiny);
+    run (huge);
+    run (growth);
+    run (reserve);
     run (append_fmt);
     run (append_fmt_strict);
     run (resize);
     run (reset);
     run (adjust);
     run (trim);
+    run (trim_sides);
     run (equal);
+    run (hash);
+    run (find);
+    run (share);
+    run (share_threads);
     run (story);
 
     printf ("unit tests OK\n");
@@ -0,0 +1,120 @@
+/*
+Stricks - Managed C strings library
+Copyright (C) 2021 - Francois Alcover <francois[@]alcover.fr>
+NO WARRANTY EXPRESSED OR IMPLIED
+*/
+
+// stx.hpp against snprintf
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "stx.hpp"
+
+#define ASSERT_STR(a, b) { if (strcmp(a, b)) {\
+fprintf(stderr, "%d: %s:'%s' != %s:'%s'\n", __LINE__, #a, a, #b, b); \
+exit(1);}}
+
+// stx::append onto a prefix, then stx::format, both against snprintf
+#define CHECK(fmt, ...) { \
+    char exp[512]; \
+    snprintf (exp, sizeof(exp), "pre" fmt, ##__VA_ARGS__); \
+    stx_t s = stx_from("pre"); \
+    stx::append (&s, STX_FMT(fmt), ##__VA_ARGS__); \
+    ASSERT_STR (s, exp); \
+    stx_free(s); \
+    snprintf (exp, sizeof(exp), fmt, ##__VA_ARGS__); \
+    s = stx::format (STX_FMT(fmt), ##__VA_ARGS__); \
+    ASSERT_STR (s, exp); \
+    stx_free(s); \
+}
+
+static void
+conversions()
+{
+    const std::string str = "bar";
+    const stx_view view = {"bazz", 3};
+    const char* cstr = "foo";
+
+    CHECK ("%s|%s|%s", cstr, str.c_str(), "baz");
+    {
+        // std::string and stx_view have no printf counterpart
+        stx_t s = stx::format (STX_FMT("%s|%s|%s"), cstr, str, view);
+        ASSERT_STR (s, "foo|bar|baz");
+        stx_free(s);
+    }
+
+    CHECK ("%d %i %d", 0, -42, INT32_MAX);
+    CHECK ("%d", INT32_MIN);
+    CHECK ("%u %u", 0u, UINT32_MAX);
+    CHECK ("%x %x", 0u, 0xdeadbeefu);
+    CHECK ("%c%c", 'a', 'z');
+
+    // narrow types are promoted to int, as printf does
+    const char nc = -1;
+    const short ns = -2;
+    CHECK ("%x %x", nc, ns);
+    CHECK ("%u %u", nc, ns);
+    CHECK ("%d %d", nc, ns);
+    CHECK ("%x", -1);
+
+    CHECK ("%.0f %.1f %.3f", 2.5, -0.25, 3.14159);
+    CHECK ("%.2f", 1e20);
+    CHECK ("%f", 1.0/3);
+    {
+        // shortest round-trip : same as the %.17g value when read back
+        stx_t s = stx::format (STX_FMT("%g"), 0.1);
+        ASSERT_STR (s, "0.1");
+        stx_free(s);
+        s = stx::format (STX_FMT("%g"), 1.0/3);
+        if (strtod(s, NULL) != 1.0/3) {fprintf(stderr, "%d: %%g round-trip\n", __LINE__); exit(1);}
+        stx_free(s);
+    }
+
+    CHECK ("100%%");
+    CHECK ("%%%d%%", 5);
+}
+
+static void
+layout()
+{
+    CHECK ("literal only");
+    {
+        stx_t s = stx::format (STX_FMT(""));
+        ASSERT_STR (s, "");
+        stx_free(s);
+    }
+    CHECK ("%d at start", 1);
+    CHECK ("at end %d", 2);
+    CHECK ("%d", 3);
+    CHECK ("%s%s", "a", "b");
+    CHECK ("%s and %d and %c.", "x", 7, 'y');
+}
+
+static void
+growth()
+{
+    // output longer than the initial capacity, one growth
+    const std::string big (1000, 'x');
+    char exp[2048];
+    snprintf (exp, sizeof(exp), "[%s|%d]", big.c_str(), 12345);
+
+    stx_t s = stx_new(0);
+    stx::append (&s, STX_FMT("[%s|%d]"), big, 12345);
+    ASSERT_STR (s, exp);
+    stx_free(s);
+}
+
+#define run(name) { name(); printf("%s OK\n", #name); }
+
+int main()
+{
+    run (conversions);
+    run (layout);
+    run (growth);
+
+    printf ("C++ tests OK\n");
+    return 0;
+}
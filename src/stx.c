@@ -19,17 +19,32 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stddef.h>
 #include <string.h>
 #include <strings.h>
-#include <ctype.h> // isspace
+#include <ctype.h> // isdigit
 #include <math.h>
 #include <assert.h>
 #include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h> // sysconf
+
+#if defined(__x86_64__) && defined(__GNUC__)
+    #define STX_X86
+    #include <immintrin.h>
+#endif
 
 #include "stx.h"
 #include "log.h"
+
+// Allocator slack : real size of a block
+#if !defined(STX_USABLE_SIZE) && defined(STX_SYSTEM_ALLOC) && defined(__GLIBC__)
+    #include <malloc.h>
+    #define STX_USABLE_SIZE(block) malloc_usable_size(block)
+#endif
 #include "util.c"
 
 typedef struct {   
@@ -37,47 +52,148 @@ typedef struct {
     uint8_t len; 
 } Head1;
 
+typedef struct {   
+    uint16_t cap;  
+    uint16_t len; 
+} Head2;
+
 typedef struct {   
     uint32_t cap;  
     uint32_t len; 
 } Head4;
 
+typedef struct {   
+    uint64_t cap;  
+    uint64_t len; 
+} Head8;
+
 typedef struct {   
     uint8_t flags;
     char data[]; 
 } Attr;
 
+typedef atomic_size_t Refs;
+typedef _Atomic uint64_t HashSlot; // may be filled from several threads
+
 typedef enum {
+    TYPE0 = 0, // tiny : dims packed in the flags byte
     TYPE1 = 1,
-    TYPE4 = 3 
+    TYPE2 = 2,
+    TYPE4 = 3,
+    TYPE8 = 4 
 } Type;
 
+// Flags : type in low bits, attributes above
+#define TYPE_MASK 0x07
+#define FOREIGN 0x08 // block inside a larger allocation : never realloc'd nor freed alone
+#define HASHED 0x10 // hash slot before the head, see stx_hash : never tiny nor foreign
+#define SHARED 0x20 // refcount before the head, see stx_share_enable : never tiny nor foreign
+#define FROZEN 0x40 // interned, see stx_intern : read-only, never tiny
+// Tiny flags : TINY | cap<<4 | FOREIGN | len
+#define TINY 0x80
+#define TINY_DIMS 0x77
+
+#define TINY_MAX 7 // max TYPE0 capacity
 #define SMALL_MAX 255 // max TYPE1 capacity
-#define TYPE_FOR(len) ((len <= SMALL_MAX) ? TYPE1 : TYPE4)
-
-#define DATAOFF(type) ((1<<type) + offsetof(Attr,data))
+#define MEDIUM_MAX 65535 // max TYPE2 capacity
+#define LARGE_MAX UINT32_MAX // max TYPE4 capacity
+#define TYPE_FOR(len) ((len <= TINY_MAX) ? TYPE0 : (len <= SMALL_MAX) ? TYPE1 \
+                      : (len <= MEDIUM_MAX) ? TYPE2 : (len <= LARGE_MAX) ? TYPE4 : TYPE8)
+#define TYPE_MAX(type) ((type) == TYPE0 ? TINY_MAX : (type) == TYPE1 ? SMALL_MAX \
+                       : (type) == TYPE2 ? MEDIUM_MAX : (type) == TYPE4 ? LARGE_MAX : SIZE_MAX)
+
+#define DATAOFF(type) (((1<<(type)) & ~1) + offsetof(Attr,data))
+static_assert (DATAOFF(TYPE0)==1, "bad TYPE0 DATAOFF");
 static_assert (DATAOFF(TYPE1)==3, "bad TYPE1 DATAOFF");
+static_assert (DATAOFF(TYPE2)==5, "bad TYPE2 DATAOFF");
 static_assert (DATAOFF(TYPE4)==9, "bad TYPE4 DATAOFF");
+static_assert (DATAOFF(TYPE8)==17, "bad TYPE8 DATAOFF");
 
 #define HEAD(s) ((char*)(s) - DATAOFF(TYPE(s)))
 #define HEADT(s,type) ((char*)(s) - DATAOFF(type))
 #define DATA(head,type) ((char*)(head) + DATAOFF(type))
 #define BLOCKSZ(type,cap) (DATAOFF(type) + cap + 1)
 #define FLAGS(s) (((uint8_t*)(s))[-1])
-#define TYPE(s) (FLAGS(s))
+// TYPE0 if TINY is set, without branching
+#define TYPE(s) (FLAGS(s) & TYPE_MASK & ((FLAGS(s) >> 7) - 1))
+// Prefix slots, before the head : [refcount][hash][head]
+// Their flags are tiny cap bits.
+#define PREFIXED(s) ((FLAGS(s) & TINY) ? 0 : FLAGS(s) & (HASHED|SHARED))
+#define IS_HASHED(s) ((FLAGS(s) & (TINY|HASHED)) == HASHED)
+#define IS_SHARED(s) ((FLAGS(s) & (TINY|SHARED)) == SHARED)
+#define IS_FROZEN(s) ((FLAGS(s) & (TINY|FROZEN)) == FROZEN)
+#define HASHSZ sizeof(HashSlot)
+#define REFSZ sizeof(Refs)
+#define PREFIX_OF(attrs) ((((attrs) & HASHED) ? HASHSZ : 0) + (((attrs) & SHARED) ? REFSZ : 0))
+#define PREFIX(s) PREFIX_OF(PREFIXED(s)) // block bytes before the head
+#define HASHSLOT(s) ((HashSlot*)(HEAD(s) - HASHSZ)) // 0 until computed
+#define REFS(s) ((Refs*)(HEAD(s) - PREFIX(s))) // block start
+#define FIELDSZ(type) (1<<((type) ? (type)-1 : 0)) // cap/len width
+// align a head offset to its field width
+#define HALIGN(off,type) (((off) + FIELDSZ(type)-1) & ~(size_t)(FIELDSZ(type)-1))
 
 #define LIST_LOCAL_MAX (STX_LOCAL_MEM/sizeof(stx_t))
-#define LIST_POOL_MAX (STX_LIST_POOL_MEM/sizeof(stx_t))
+
+// Branch-free head reads : one unaligned 8-byte load masked to the field width.
+// Any block must stay readable LOAD_PAD bytes past a head field, hence
+// a minimum heap block and padding after packed blocks and arena chunks.
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    #define FLAT_LOADS
+#endif
+
+#define LOAD_PAD 8
+#define BLOCK_MIN ((size_t)FIELDSZ(TYPE8) + LOAD_PAD)
+
+// Heap block size, with `pre` bytes of hash slot kept apart from BLOCK_MIN
+static inline size_t
+heapsz (const size_t pre, const Type type, const size_t cap) {
+    const size_t sz = BLOCKSZ(type, cap);
+    return pre ? pre + max(sz, BLOCK_MIN) : sz;
+}
 
 //==== PRIVATE =================================================================
 
-static stx_t list_pool[LIST_POOL_MAX] = {NULL};
+#ifdef FLAT_LOADS
+
+static inline uint64_t
+load8 (const void* p) {
+    uint64_t v;
+    memcpy (&v, p, sizeof(v));
+    return v;
+}
+
+// by type : field width mask, len offset from head, len offset before data,
+// cap shift (TYPE0 head is the flags byte)
+static const uint64_t FIELDMASK[8] = {TINY_MAX, 0xff, 0xffff, 0xffffffff, UINT64_MAX};
+static const uint8_t LENOFF[8] = {0, 1, 2, 4, 8};
+static const uint8_t LENPOS[8] = {1, 2, 3, 5, 9};
+static const uint8_t CAPSHIFT[8] = {4};
+
+static inline size_t 
+hgetcap (const void* head, const Type type) { 
+    return (load8(head) >> CAPSHIFT[type]) & FIELDMASK[type];
+}
+
+static inline size_t 
+hgetlen (const void* head, const Type type) { 
+    return load8((char*)head + LENOFF[type]) & FIELDMASK[type];
+}
+
+static inline Head8
+hgetdims (const void* head, const Type type) {
+    return (Head8){hgetcap(head, type), hgetlen(head, type)};
+}
+
+#else
 
 static inline size_t 
 hgetcap (const void* head, const Type type) { 
     switch(type) { 
+        case TYPE0: return (*(uint8_t*)head >> 4) & TINY_MAX; 
         case TYPE1: return ((Head1*)head)->cap; 
+        case TYPE2: return ((Head2*)head)->cap; 
         case TYPE4: return ((Head4*)head)->cap; 
+        case TYPE8: return ((Head8*)head)->cap; 
         default: ERR("Bad head type"); exit(1);
     }
 }
@@ -85,17 +201,39 @@ hgetcap (const void* head, const Type type) {
 static inline size_t 
 hgetlen (const void* head, const Type type) { 
     switch(type) { 
+        case TYPE0: return *(uint8_t*)head & TINY_MAX; 
         case TYPE1: return ((Head1*)head)->len; 
+        case TYPE2: return ((Head2*)head)->len; 
         case TYPE4: return ((Head4*)head)->len; 
+        case TYPE8: return ((Head8*)head)->len; 
         default: ERR("Bad head type"); exit(1);
     }
 }
 
+static inline Head8
+hgetdims (const void* head, const Type type) {
+    switch(type) {
+        case TYPE0: return (Head8){hgetcap(head, type), hgetlen(head, type)};
+        case TYPE1: return (Head8){((Head1*)head)->cap, ((Head1*)head)->len};
+        case TYPE2: return (Head8){((Head2*)head)->cap, ((Head2*)head)->len};
+        case TYPE4: return (Head8){((Head4*)head)->cap, ((Head4*)head)->len};
+        case TYPE8: return *(Head8*)head;
+        default: ERR("Bad head type"); exit(1);
+    } 
+}
+
+#endif
+
+// Setters keep a store of the field width : a wider write could race
+// with a neighbour block in a pack or arena.
 static inline void 
 hsetcap (const void* head, const Type type, const size_t val) { 
     switch(type) { 
+        case TYPE0: *(uint8_t*)head = (*(uint8_t*)head & ~0x70) | val<<4; break; 
         case TYPE1: ((Head1*)head)->cap = val; break; 
+        case TYPE2: ((Head2*)head)->cap = val; break; 
         case TYPE4: ((Head4*)head)->cap = val; break; 
+        case TYPE8: ((Head8*)head)->cap = val; break; 
         default: ERR("Bad head type"); exit(1);
     } 
 }
@@ -103,34 +241,50 @@ hsetcap (const void* head, const Type type, const size_t val) {
 static inline void 
 hsetlen (const void* head, const Type type, const size_t val) { 
     switch(type) { 
+        case TYPE0: *(uint8_t*)head = (*(uint8_t*)head & ~TINY_MAX) | val; break; 
         case TYPE1: ((Head1*)head)->len = val; break; 
+        case TYPE2: ((Head2*)head)->len = val; break; 
         case TYPE4: ((Head4*)head)->len = val; break; 
+        case TYPE8: ((Head8*)head)->len = val; break; 
         default: ERR("Bad head type"); exit(1);
     }
 }
 
-static inline Head4
-hgetdims (const void* head, const Type type) {
-    switch(type) {
-        case TYPE1: return (Head4){((Head1*)head)->cap, ((Head1*)head)->len};
-        case TYPE4: return *(Head4*)head;
-        default: ERR("Bad head type"); exit(1); \
-    } 
-}
-
 static inline void
-hsetdims (const void* head, const Type type, const Head4 dims) {
+hsetdims (const void* head, const Type type, const Head8 dims) {
     switch(type) {
+        case TYPE0: *(uint8_t*)head = TINY | dims.cap<<4 | dims.len; break; // attrs reset
         case TYPE1: *((Head1*)head) = (Head1){dims.cap, dims.len}; break;
-        case TYPE4: *((Head4*)head) = (Head4)dims; break;
+        case TYPE2: *((Head2*)head) = (Head2){dims.cap, dims.len}; break;
+        case TYPE4: *((Head4*)head) = (Head4){dims.cap, dims.len}; break;
+        case TYPE8: *((Head8*)head) = dims; break;
         default: ERR("Bad head type"); exit(1);
     } 
 }
 
+// Set type and attributes, keeping tiny dims
+static inline void
+setflags (stx_t s, const Type type, const uint8_t attrs) {
+    if (type == TYPE0)
+        FLAGS(s) = (FLAGS(s) & TINY_DIMS) | TINY | attrs;
+    else
+        FLAGS(s) = type | attrs;
+}
+
 static inline size_t
 getlen (stx_t s) {
     const Type type = TYPE(s);
-    return hgetlen (HEADT(s,type), type); //opt ?
+#ifdef FLAT_LOADS
+    return load8(s - LENPOS[type]) & FIELDMASK[type];
+#else
+    return hgetlen (HEADT(s,type), type);
+#endif
+}
+
+// Drop a cached hash : on any content change
+static inline void
+unhash (stx_t s) {
+    if (IS_HASHED(s)) atomic_store_explicit (HASHSLOT(s), 0, memory_order_relaxed);
 }
 
 static inline void
@@ -138,106 +292,489 @@ setlen (stx_t s, const size_t len) {
     const Type type = TYPE(s);
     void* head = HEADT(s, type);
     hsetlen(head, type, len);
+    unhash(s);
+}
+
+// Unaligned reads for hashing
+static inline uint64_t
+rd64 (const char* p) {
+    uint64_t v;
+    memcpy (&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t
+rd32 (const char* p) {
+    uint32_t v;
+    memcpy (&v, p, sizeof(v));
+    return v;
+}
+
+// 64x64 multiply, high and low halves folded
+static inline uint64_t
+mix (const uint64_t a, const uint64_t b) {
+#ifdef __SIZEOF_INT128__
+    const unsigned __int128 r = (unsigned __int128)a * b;
+    return (uint64_t)r ^ (uint64_t)(r >> 64);
+#else
+    const uint64_t ha = a >> 32, la = (uint32_t)a, hb = b >> 32, lb = (uint32_t)b;
+    const uint64_t hh = ha*hb, hl = ha*lb, lh = la*hb, ll = la*lb;
+    const uint64_t lo = ll + (hl << 32);
+    const uint64_t carry = (lo < ll) + ((lo + (lh << 32)) < lo);
+    return (lo + (lh << 32)) ^ (hh + (hl >> 32) + (lh >> 32) + carry);
+#endif
+}
+
+#define HK0 0xa0761d6478bd642full
+#define HK1 0xe7037ed1a0b428dbull
+#define HK2 0x8ebc6af09c88c6e3ull
+#define HK3 0x589965cc75374cc3ull
+
+// wyhash-style : 16 bytes per multiply, 3 lanes past 48 bytes.
+// Never 0, which marks an empty hash slot.
+static uint64_t
+hash_mem (const char* p, const size_t len)
+{
+    uint64_t seed = HK0;
+    uint64_t a, b;
+
+    if (len <= 16) {
+        if (len >= 4) {
+            const size_t mid = (len >> 3) << 2;
+            a = (rd32(p) << 32) | rd32(p + mid);
+            b = (rd32(p + len-4) << 32) | rd32(p + len-4 - mid);
+        } else if (len) {
+            a = ((uint64_t)(uint8_t)p[0] << 16) | ((uint64_t)(uint8_t)p[len>>1] << 8) | (uint8_t)p[len-1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if (i > 48) {
+            uint64_t seed1 = seed, seed2 = seed;
+            do {
+                seed = mix (rd64(p) ^ HK1, rd64(p+8) ^ seed);
+                seed1 = mix (rd64(p+16) ^ HK2, rd64(p+24) ^ seed1);
+                seed2 = mix (rd64(p+32) ^ HK3, rd64(p+40) ^ seed2);
+                p += 48; 
+                i -= 48;
+            } while (i > 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while (i > 16) {
+            seed = mix (rd64(p) ^ HK1, rd64(p+8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        a = rd64(p + i-16);
+        b = rd64(p + i-8);
+    }
+
+    const uint64_t h = mix (HK1 ^ len, mix (a ^ HK1, b ^ seed));
+    return h ? h : 1;
+}
+
+
+//==== POOL ====================================================================
+
+#ifdef STX_USABLE_SIZE
+    #define SYS_USABLE(block,size) STX_USABLE_SIZE(block)
+#else
+    #define SYS_USABLE(block,size) (size)
+#endif
+
+// Optional per-thread free lists of small blocks, by size class.
+// Heap blocks of stricks go through halloc/hfree/hrealloc.
+
+#ifdef STX_POOL
+
+#define POOL_STEP 16
+#define POOL_MAX BLOCKSZ(TYPE1, SMALL_MAX) // largest TYPE1 block
+#define POOL_CLASSES ((POOL_MAX + POOL_STEP-1) / POOL_STEP)
+#define POOL_CLASS(size) (((size) + POOL_STEP-1) / POOL_STEP - 1)
+
+typedef struct Slot {struct Slot* next;} Slot;
+
+static _Thread_local Slot* pool_slots[POOL_CLASSES];
+static _Thread_local unsigned pool_count[POOL_CLASSES];
+
+static inline void*
+halloc (const size_t size)
+{
+    if (size > POOL_MAX) return STX_MALLOC(size);
+
+    const int c = POOL_CLASS(size);
+    Slot* slot = pool_slots[c];
+
+    if (slot) {
+        pool_slots[c] = slot->next;
+        --pool_count[c];
+        return slot;
+    }
+
+    return STX_MALLOC((c+1) * POOL_STEP);
+}
+
+static inline void
+hfree (void* block, const size_t size)
+{
+    if (size > POOL_MAX) {STX_FREE(block); return;}
+    
+    const int c = POOL_CLASS(size);
+
+    if (pool_count[c] >= STX_POOL_KEEP) {STX_FREE(block); return;}
+
+    ((Slot*)block)->next = pool_slots[c];
+    pool_slots[c] = block;
+    ++pool_count[c];
+}
+
+// Usable size of a block allocated for `size`
+static inline size_t
+husable (void* block, const size_t size)
+{
+    if (size > POOL_MAX) return SYS_USABLE(block, size);
+    return (POOL_CLASS(size)+1) * POOL_STEP;
+}
+
+static inline void*
+hrealloc (void* block, const size_t oldsize, const size_t newsize)
+{
+    if (oldsize > POOL_MAX && newsize > POOL_MAX) 
+        return STX_REALLOC(block, newsize);
+    
+    if (oldsize <= POOL_MAX && newsize <= POOL_MAX 
+    && POOL_CLASS(oldsize) == POOL_CLASS(newsize)) 
+        return block;
+
+    void* ret = halloc(newsize);
+    if (!ret) return NULL;
+    memcpy (ret, block, min(oldsize, newsize));
+    hfree (block, oldsize);
+    
+    return ret;
+}
+
+#else
+
+#define halloc(size) STX_MALLOC(max(size, BLOCK_MIN))
+#define hfree(block,size) STX_FREE(block)
+#define hrealloc(block,oldsize,newsize) STX_REALLOC(block, max(newsize, BLOCK_MIN))
+#define husable(block,size) SYS_USABLE(block,size)
+
+#endif
+
+//==== ARENA ===================================================================
+
+typedef struct Chunk {
+    struct Chunk* next; // older chunk
+    size_t size;
+    size_t used;
+    char mem[];
+} Chunk;
+
+struct stx_arena {
+    Chunk* chunk; // current
+    size_t chunksz;
+};
+
+static Chunk*
+chunk_new (const size_t size)
+{
+    Chunk* c = STX_MALLOC(sizeof(Chunk) + size + LOAD_PAD);
+    if (!c) return NULL;
+    *c = (Chunk){NULL, size, 0};
+    return c;
+}
+
+// Bump-allocate `size` bytes aligned to `align` (power of 2).
+static void*
+arena_alloc (stx_arena* a, const size_t size, const size_t align)
+{
+    Chunk* c = a->chunk;
+    const uintptr_t base = (uintptr_t)c->mem;
+    size_t off = ((base + c->used + align-1) & ~(uintptr_t)(align-1)) - base;
+
+    if (off + size > c->size) {
+        Chunk* fresh = chunk_new (max(a->chunksz, size+align));
+        if (!fresh) return NULL;
+        fresh->next = c;
+        a->chunk = c = fresh;
+        off = (((uintptr_t)c->mem + align-1) & ~(uintptr_t)(align-1)) - (uintptr_t)c->mem;
+    }
+
+    c->used = off + size;
+    return c->mem + off;
+}
+
+// Extend `block` in place if it is the last allocation and room remains.
+static int
+arena_extend (stx_arena* a, const void* block, const size_t oldsize, const size_t newsize)
+{
+    Chunk* c = a->chunk;
+    const uintptr_t off = (uintptr_t)block - (uintptr_t)c->mem;
+
+    if (off + oldsize != c->used || off + newsize > c->size) return 0;
+
+    c->used = off + newsize;
+    return 1;
+}
+
+//==============================================================================
+
+// Block from heap, or from arena `a` if given.
+static inline void*
+balloc (stx_arena* a, const size_t size, const Type type)
+{
+    return a ? arena_alloc (a, size, FIELDSZ(type)) : halloc(size);
 }
 
 
 static inline stx_t 
-new (const size_t cap)
+new_in (stx_arena* a, const size_t cap)
 {
     const Type type = TYPE_FOR(cap);
-    void* head = STX_MALLOC(BLOCKSZ(type, cap));
+    void* head = balloc(a, BLOCKSZ(type, cap), type);
     if (!head) return NULL;
 
-    hsetdims(head, type, (Head4){cap, 0});
+    hsetdims(head, type, (Head8){cap, 0});
 
     char* data = DATA(head,type);
     data[0] = 0; 
     data[cap] = 0; 
 
-    FLAGS(data) = type;
+    setflags (data, type, a ? FOREIGN : 0);
     
     return data;
 }
 
 
 static inline stx_t 
-from (const char* src, const size_t srclen)
+from_in (stx_arena* a, const char* src, const size_t srclen)
 {
     const Type type = TYPE_FOR(srclen);
-    void* head = STX_MALLOC(BLOCKSZ(type, srclen));
+    void* head = balloc(a, BLOCKSZ(type, srclen), type);
     if (!head) return NULL;
 
-    hsetdims(head, type, (Head4){srclen, srclen});
+    hsetdims(head, type, (Head8){srclen, srclen});
 
     char* data = DATA(head,type);
     memcpy (data, src, srclen);
     data[srclen] = 0; 
 
-    FLAGS(data) = type;
+    setflags (data, type, a ? FOREIGN : 0);
 
     return data;
 }
 
+static inline stx_t new (const size_t cap) {return new_in(NULL, cap);}
+static inline stx_t from (const char* src, const size_t srclen) {return from_in(NULL, src, srclen);}
+
+
+// Shared with other references : read-only
+static inline int
+shared (stx_t s) {
+    return IS_SHARED(s) && atomic_load_explicit(REFS(s), memory_order_acquire) > 1;
+}
+
+// Shared or interned : in-place mutators refuse
+static inline int
+readonly (stx_t s) {
+    return IS_FROZEN(s) || shared(s);
+}
+
+// Copy-on-write : before mutating *ps in place or moving it,
+// trade our reference for a private copy.
+static inline int
+unshare (stx_t* ps)
+{
+    stx_t s = *ps;
+    if (!readonly(s)) return 1;
+
+    stx_t copy = from (s, getlen(s));
+    if (!copy) {ERR("unshare: alloc"); return 0;}
+
+    stx_free(s);
+    *ps = copy;
+    return 1;
+}
+
+
+// Growth policy of appenders, see stx_set_growth
+static stx_growth growth = STX_GROW_DOUBLE;
+
+#define PAGE_SZ 4096
+
+// Capacity to reserve when `needed` exceeds current capacity
+static inline size_t
+growcap (const size_t needed)
+{
+    if (needed > SIZE_MAX/4) return needed; // no room to spare
+
+    switch (growth) {
+        
+        case STX_GROW_HALF: 
+            return needed + needed/2;
+        
+        case STX_GROW_CAPPED: 
+            return needed + min(needed, (size_t)STX_GROW_STEP);
+        
+        case STX_GROW_ROUND: {
+            // whole block to power of 2, then to page multiple
+            size_t sz = BLOCKSZ(TYPE_FOR(needed), needed);
+            if (sz <= PAGE_SZ) {
+                size_t p2 = 16;
+                while (p2 < sz) p2 <<= 1;
+                sz = p2;
+            } else {
+                sz = (sz + PAGE_SZ-1) & ~(size_t)(PAGE_SZ-1);
+            }
+            return needed + (sz - BLOCKSZ(TYPE_FOR(needed), needed));
+        }
+
+        default:
+            return 2*needed;
+    }
+}
+
+
+// Capacity of heap `block` of requested `size`, 
+// including allocator slack, within type bounds.
+static inline size_t
+fitcap (void* block, const size_t size, const Type type, const size_t cap)
+{
+    return min(cap + (husable(block, size) - size), (size_t)TYPE_MAX(type));
+}
+
 
 // resize increase only, to new location
+// Foreign blocks are extended in place when last in arena `a`, 
+// else moved to a new block from `a` or the heap.
+// With `slack`, a heap block keeps any extra room the allocator gave.
 static inline void* 
-grow (stx_t *ps, const size_t newcap, 
-    const void* head, const Type type, const Head4 dims)
+grow (stx_arena* a, stx_t *ps, const size_t newcap, 
+    const void* head, const Type type, const Head8 dims, const int slack)
 {    
     stx_t s = *ps;
-    void* newhead;
-    char* newdata;
-    size_t newsize;
-
-    #define RELOC(t) \
-    newsize = BLOCKSZ (TYPE##t, newcap); \
-    newhead = STX_REALLOC ((void*)head, newsize); \
-    if (!newhead) {ERR("failed realloc(%zu)", newsize); return NULL;} \
-    ((Head##t*)newhead)->cap = newcap; \
-    newdata = DATA(newhead, TYPE##t);
-
-    // TYPE4 -> TYPE4
-    if (type == TYPE4) {
-        RELOC(4)
-        goto fin;
-    }
+    // never narrow the head : dims.len may exceed TYPE_MAX(TYPE_FOR(newcap))
+    const Type fit = TYPE_FOR(newcap);
+    const Type newtype = (fit > type) ? fit : type;
 
-    // TYPE1 -> TYPE1
-    if (newcap <= SMALL_MAX) {
-        RELOC(1)
-        goto fin;
+    if (FLAGS(s) & FOREIGN) {
+
+        if (a && newtype == type
+        && arena_extend (a, head, BLOCKSZ(type, dims.cap), BLOCKSZ(type, newcap))) {
+            hsetcap (head, type, newcap);
+            ((char*)s)[newcap] = 0;
+            return (void*)head;
+        }
+
+        char* newdata = (char*)new_in(a, newcap);
+        if (!newdata) {ERR("failed new(%zu)", newcap); return NULL;}
+        memcpy (newdata, s, dims.len+1);
+        setlen (newdata, dims.len);
+        *ps = newdata;
+        return HEAD(newdata);
     }
 
-    // TYPE1 -> TYPE4
-    RELOC(4)
-    memcpy (newdata, DATA(newhead, TYPE1), dims.len+1); 
-    ((Head4*)newhead)->len = dims.len;
-    FLAGS(newdata) = TYPE4;
+    const uint8_t attrs = PREFIXED(s);
+    const size_t pre = PREFIX_OF(attrs);
+    const size_t newsize = heapsz(pre, newtype, newcap);
+    char* block = hrealloc ((char*)head - pre, heapsz(pre, type, dims.cap), newsize);
+    if (!block) {ERR("failed realloc(%zu)", newsize); return NULL;}
+    
+    void* newhead = block + pre;
+    char* newdata = DATA(newhead, newtype);
+    const size_t cap = slack ? fitcap(block, newsize, newtype, newcap) : newcap;
+
+    if (newtype == type) {
+        hsetcap (newhead, type, cap);
+    } else {
+        // move data before the wider head overwrites it
+        memmove (newdata, DATA(newhead, type), dims.len+1);
+        hsetdims (newhead, newtype, (Head8){cap, dims.len});
+        setflags (newdata, newtype, attrs);
+    }
 
-    fin:
-    newdata[newcap] = 0; // add cap sentinel
+    newdata[cap] = 0; // add cap sentinel
     *ps = newdata;
 
     return newhead;
+}
+
+//==== PARALLEL ================================================================
+
+// Parallel policy, see stx_set_parallel
+static int par_threads = 0; // 0 : online CPUs
+static size_t par_min = STX_PAR_MIN;
+
+// Threads for a job over `bytes`, 1 below threshold
+static int
+par_threads_for (const size_t bytes)
+{
+    if (bytes < par_min) return 1;
+
+    long n = par_threads;
+    if (!n) n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (n < 1) ? 1 : (n > STX_THREADS) ? STX_THREADS : n;
+}
+
+// Blocks 0..nblocks-1 pulled by workers from a shared counter
+typedef struct {
+    void (*fn) (void* ctx, int block);
+    void* ctx;
+    int nblocks;
+    atomic_int next;
+} Job;
+
+static void*
+job_worker (void* arg)
+{
+    Job* job = arg;
+    int b;
+    while ((b = atomic_fetch_add_explicit(&job->next, 1, memory_order_relaxed)) < job->nblocks) 
+        job->fn (job->ctx, b);
+    return NULL;
+}
 
-    #undef RELOC
+// Run the blocks on `threads` threads, the caller being one.
+// Fewer if thread creation fails : the caller does what remains.
+static void
+run_blocks (const int threads, const int nblocks, void (*fn)(void*, int), void* ctx)
+{
+    Job job = {.fn = fn, .ctx = ctx, .nblocks = nblocks};
+    atomic_init (&job.next, 0);
+
+    pthread_t tids[STX_THREADS];
+    int spawned = 0;
+
+    for (int t = 1; t < threads && t < nblocks; ++t)
+        if (!pthread_create (&tids[spawned], NULL, job_worker, &job)) ++spawned;
+
+    job_worker (&job);
+
+    for (int t = 0; t < spawned; ++t)
+        pthread_join (tids[t], NULL);
 }
 
 //==== PUBLIC ==================================================================
 
-size_t 
-stx_append (stx_t* dst, const void* src, const size_t srclen) 
+static inline size_t 
+append (stx_arena* a, stx_t* dst, const void* src, const size_t srclen) 
 {
+    if (!unshare(dst)) return 0;
     stx_t s = *dst;
     
     const Type type = TYPE(s);
     void* head = HEADT(s, type);
-    const Head4 dims = hgetdims(head,type);
+    const Head8 dims = hgetdims(head,type);
     const size_t totlen = dims.len + srclen;
 
     if (totlen > dims.cap) {  
 
-        head = grow (dst, totlen*2, head, type, dims);
+        head = grow (a, dst, growcap(totlen), head, type, dims, 1);
         
         if (!head) {
             ERR("failed grow()");
@@ -252,17 +789,91 @@ stx_append (stx_t* dst, const void* src, const size_t srclen)
     memcpy (end, src, srclen);
     end[srclen] = 0;
     hsetlen (head, TYPE(s), totlen);
+    unhash(s);
 
     return totlen;              
 }
 
 
+size_t 
+stx_append (stx_t* dst, const void* src, const size_t srclen) 
+{
+    return append (NULL, dst, src, srclen);
+}
+
+
+// Append `count` parts with one capacity check and one length update
+size_t 
+stx_appendv (stx_t* dst, const stx_view* parts, const int count) 
+{
+    size_t srclen = 0;
+    for (int i = 0; i < count; ++i) 
+        srclen += parts[i].len;
+
+    if (!unshare(dst)) return 0;
+    stx_t s = *dst;
+    const Type type = TYPE(s);
+    void* head = HEADT(s, type);
+    const Head8 dims = hgetdims(head,type);
+    const size_t totlen = dims.len + srclen;
+
+    if (totlen > dims.cap) {  
+        head = grow (NULL, dst, growcap(totlen), head, type, dims, 1);
+        if (!head) {
+            ERR("failed grow()");
+            return 0;
+        }
+        s = *dst;
+    }
+
+    char* end = (char*)s + dims.len;
+
+    for (int i = 0; i < count; ++i) {
+        memcpy (end, parts[i].data, parts[i].len);
+        end += parts[i].len;
+    }
+
+    *end = 0;
+    hsetlen (head, TYPE(s), totlen);
+    unhash(s);
+
+    return totlen;
+}
+
+
+// NULL-terminated C strings
+size_t 
+stx_append_many (stx_t* dst, ...) 
+{
+    stx_view parts[STX_LOCAL_MEM/sizeof(stx_view)];
+    const int parts_max = sizeof(parts)/sizeof(parts[0]);
+    int count = 0;
+    const char* str;
+
+    va_list args;
+    va_start(args, dst);
+    while ((str = va_arg(args, const char*))) {
+        // spill a full batch
+        if (count == parts_max) {
+            if (!stx_appendv (dst, parts, count)) {va_end(args); return 0;}
+            count = 0;
+        }
+        parts[count++] = (stx_view){str, strlen(str)};
+    }
+    va_end(args);
+
+    return count ? stx_appendv (dst, parts, count) : getlen(*dst);
+}
+
+
 long long 
 stx_append_strict (stx_t dst, const void* src, const size_t srclen) 
 {
+    if (readonly(dst)) {ERR("stx_append_strict: read-only"); return 0;}
+
     const Type type = TYPE(dst);
     void* head = HEADT(dst, type);
-    const Head4 dims = hgetdims(head,type);
+    const Head8 dims = hgetdims(head,type);
     const size_t totlen = dims.len + srclen;
 
     // Would truncate, return needed capacity
@@ -275,21 +886,61 @@ stx_append_strict (stx_t dst, const void* src, const size_t srclen)
     end[srclen] = 0;
 
     hsetlen (head, type, totlen);
+    unhash(dst);
 
     return totlen;        
 
 }
 
 
+// New heap block of `cap` (plus allocator slack) holding the content 
+// and prefix slots of s, which is left alone. Refcount 1, no cached hash.
+static stx_t
+relocate (stx_t s, const size_t len, const size_t cap)
+{
+    const uint8_t attrs = PREFIXED(s);
+    const size_t pre = PREFIX_OF(attrs);
+    const Type fit = TYPE_FOR(cap);
+    const Type type = (pre && fit == TYPE0) ? TYPE1 : fit; // tiny has no prefix
+    const size_t size = heapsz(pre, type, cap);
+
+    char* block = halloc(size);
+    if (!block) {ERR("relocate: alloc"); return NULL;}
+
+    const size_t newcap = fitcap(block, size, type, cap);
+    void* head = block + pre;
+    hsetdims (head, type, (Head8){newcap, len});
+
+    char* data = DATA(head, type);
+    memcpy (data, s, len);
+    data[len] = 0;
+    data[newcap] = 0;
+    setflags (data, type, attrs);
+
+    if (attrs & HASHED) atomic_init (HASHSLOT(data), 0);
+    if (attrs & SHARED) atomic_init (REFS(data), 1);
+
+    return data;
+}
+
+
+// Arguments may point into *dst : it is never written while they are read.
+// Short output is formatted locally then copied.
+// Longer output that needs growth goes straight into a new block when the
+// content is shorter than the output, the old block being freed after.
+// Otherwise it goes through a scratch buffer : no content copy, and realloc
+// may remap large blocks.
 size_t 
 stx_append_fmt (stx_t* dst, const char* fmt, ...) 
 {
+    if (!unshare(dst)) return 0;
     stx_t s = *dst;
 
     const Type type = TYPE(s);
     const void* head = HEADT(s,type);
-    const Head4 dims = hgetdims(head,type);
+    const Head8 dims = hgetdims(head,type);
     char local[STX_LOCAL_MEM];
+    char* out = local;
 
     va_list args, argscpy;
     va_start(args, fmt);  
@@ -301,31 +952,48 @@ stx_append_fmt (stx_t* dst, const char* fmt, ...)
 
     if (fmtlen < 0) {
         perror("vsnprintf"); 
+        va_end(argscpy);
         return 0;
     }
     
     const size_t totlen = dims.len + fmtlen;
 
-    if (totlen > dims.cap) {
+    if ((size_t)fmtlen >= sizeof(local)) {
+
+        // moving costs a copy of the content, the scratch buffer one of the output
+        if (totlen > dims.cap && dims.len <= (size_t)fmtlen) {
+            stx_t moved = relocate (s, dims.len, growcap(totlen));
+            if (!moved) {va_end(argscpy); return 0;}
+            vsnprintf ((char*)moved + dims.len, fmtlen+1, fmt, argscpy);
+            va_end(argscpy);
+            setlen(moved, totlen);
+            stx_free(s);
+            *dst = moved;
+            return totlen;
+        }
 
-        if (!grow(dst, 2*totlen, head, type, dims)) {
-            ERR("resize");
+        out = STX_MALLOC (fmtlen+1);
+        if (!out) {
+            ERR("stx_append_fmt: malloc");
+            va_end(argscpy);
             return 0;
         }
-        
-        s = *dst;
+        vsnprintf (out, fmtlen+1, fmt, argscpy);
+    }
+
+    va_end(argscpy);
+
+    if (totlen > dims.cap && !grow(NULL, dst, growcap(totlen), head, type, dims, 1)) {
+        ERR("resize");
+        return 0;
     } 
     
+    s = *dst;
     char* end = (char*)s + dims.len;
-
-    if (fmtlen < STX_LOCAL_MEM) {
-        memcpy (end, local, fmtlen);
-    } else {
-        vsprintf (end, fmt, argscpy);
-        va_end(argscpy);
-    }
-
+    memcpy (end, out, fmtlen);
     end[fmtlen] = 0;
+    if (out != local) STX_FREE(out);
+
     setlen(s, totlen);
 
     return totlen;           
@@ -335,9 +1003,11 @@ stx_append_fmt (stx_t* dst, const char* fmt, ...)
 long long 
 stx_append_fmt_strict (stx_t dst, const char* fmt, ...) 
 {
+    if (readonly(dst)) {ERR("stx_append_fmt_strict: read-only"); return 0;}
+
     const Type type = TYPE(dst);
     const void* head = HEADT(dst, type);
-    const Head4 dims = hgetdims(head,type);
+    const Head8 dims = hgetdims(head,type);
     const size_t spc = dims.cap - dims.len;
     char* end = (char*)dst + dims.len;
 
@@ -365,33 +1035,596 @@ stx_append_fmt_strict (stx_t dst, const char* fmt, ...)
 
     // Update length
     hsetlen(head, type, totlen);
+    unhash(dst);
 
     return totlen;           
 }
 
 
-int stx_resize (stx_t *ps, const size_t newcap)
-{    
-    stx_t s = *ps;
+//==== TYPED APPEND ============================================================
+
+// Room for `extra` more bytes, growing if needed. Returns end of data.
+static inline char*
+spare (stx_t* dst, const size_t extra)
+{
+    if (!unshare(dst)) return NULL;
+    stx_t s = *dst;
+    const Type type = TYPE(s);
+    void* head = HEADT(s, type);
+    const Head8 dims = hgetdims(head, type);
+
+    if (dims.cap - dims.len < extra
+    && !grow(NULL, dst, growcap(dims.len + extra), head, type, dims, 1)) {
+        ERR("failed grow()");
+        return NULL;
+    }
+
+    return (char*)*dst + dims.len;
+}
+
+// Terminate at `end` and set length. Returns new length.
+static inline size_t
+settle (stx_t s, char* end)
+{
+    *end = 0;
+    const size_t len = end - s;
+    setlen (s, len);
+    return len;
+}
+
+static const char DIGIT_PAIRS[] = 
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const uint64_t POW10[] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 
+    100000000ull, 1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull, 
+    10000000000000ull, 100000000000000ull, 1000000000000000ull, 10000000000000000ull, 
+    100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull
+};
+
+#define UINT_DIGITS_MAX 20
+#define FIXED_PREC_MAX 17
+
+// Decimal digits of v to out, two at a time. Returns end.
+static inline char*
+put_uint (char* out, uint64_t v)
+{
+    char buf[UINT_DIGITS_MAX];
+    char* p = buf + sizeof(buf);
+
+    while (v >= 100) {
+        p -= 2;
+        memcpy (p, DIGIT_PAIRS + 2*(v % 100), 2);
+        v /= 100;
+    }
+
+    if (v >= 10) {
+        p -= 2;
+        memcpy (p, DIGIT_PAIRS + 2*v, 2);
+    } else {
+        *--p = '0' + v;
+    }
+
+    const size_t n = buf + sizeof(buf) - p;
+    memcpy (out, p, n);
+    return out + n;
+}
+
+// Exactly `width` digits of v, zero-padded
+static inline char*
+put_uint_pad (char* out, uint64_t v, const int width)
+{
+    for (int i = width-1; i >= 0; --i) {
+        out[i] = '0' + v % 10;
+        v /= 10;
+    }
+    return out + width;
+}
+
+// Fixed notation of |v| scaled to integer m with `prec` decimals
+static inline char*
+put_fixed (char* out, const int neg, const uint64_t m, const int prec)
+{
+    if (neg) *out++ = '-';
+    out = put_uint (out, m / POW10[prec]);
+    if (!prec) return out;
+    *out++ = '.';
+    return put_uint_pad (out, m % POW10[prec], prec);
+}
+
+size_t stx_append_uint (stx_t* dst, const unsigned long long v)
+{
+    char* end = spare (dst, UINT_DIGITS_MAX);
+    if (!end) return 0;
+    return settle (*dst, put_uint(end, v));
+}
+
+size_t stx_append_int (stx_t* dst, const long long v)
+{
+    char* end = spare (dst, UINT_DIGITS_MAX+1);
+    if (!end) return 0;
+    if (v < 0) *end++ = '-';
+    // no overflow on LLONG_MIN
+    const uint64_t mag = v < 0 ? -(uint64_t)v : (uint64_t)v;
+    return settle (*dst, put_uint(end, mag));
+}
+
+size_t stx_append_hex (stx_t* dst, unsigned long long v)
+{
+    static const char hex[] = "0123456789abcdef";
+    char* end = spare (dst, 16);
+    if (!end) return 0;
+
+    char buf[16];
+    char* p = buf + sizeof(buf);
+    do {
+        *--p = hex[v & 0xf];
+        v >>= 4;
+    } while (v);
+
+    const size_t n = buf + sizeof(buf) - p;
+    memcpy (end, p, n);
+    return settle (*dst, end + n);
+}
+
+// Fallback through the C library, for what the fast paths refuse.
+static size_t
+append_double_slow (stx_t* dst, const double v, const int prec)
+{
+    char buf[512]; // %f of DBL_MAX is 309 digits
+    int n;
+
+    if (prec >= 0) {
+        n = snprintf (buf, sizeof(buf), "%.*f", prec, v);
+    } else {
+        // shortest %g that reads back the same
+        for (int p = 15; p <= 17; ++p) {
+            n = snprintf (buf, sizeof(buf), "%.*g", p, v);
+            if (!isfinite(v) || strtod(buf, NULL) == v) break;
+        }
+    }
+
+    if (n < 0) return 0;
+    if ((size_t)n >= sizeof(buf)) return stx_append_fmt (dst, "%.*f", prec, v);
+
+    return append (NULL, dst, buf, n);
+}
+
+#ifdef __SIZEOF_INT128__
+
+// |v| * 10^prec rounded half-even, exactly as printf does.
+// 0 if it would not fit in 64 bits.
+static inline int
+scale_exact (const double v, const int prec, uint64_t* out)
+{
+    uint64_t bits;
+    memcpy (&bits, &v, sizeof(bits));
+    const int bexp = (bits >> 52) & 0x7ff;
+    const uint64_t frac = bits & ((1ull << 52) - 1);
+    // |v| = mant * 2^exp
+    const uint64_t mant = bexp ? frac | (1ull << 52) : frac;
+    const int exp = bexp ? bexp - 1075 : -1074;
+
+    const unsigned __int128 num = (unsigned __int128)mant * POW10[prec];
+
+    if (exp >= 0) {
+        if (exp >= 64 || num >> (64 - exp)) return 0;
+        *out = (uint64_t)num << exp;
+        return 1;
+    }
+
+    const int shift = -exp;
+    if (shift >= 128) {*out = 0; return 1;}
+
+    unsigned __int128 q = num >> shift;
+    const unsigned __int128 rem = num - (q << shift);
+    const unsigned __int128 half = (unsigned __int128)1 << (shift-1);
+    if (rem > half || (rem == half && (q & 1))) ++q;
+
+    if (q >> 64) return 0;
+    *out = q;
+    return 1;
+}
+
+#endif
+
+// prec >= 0 : fixed with `prec` decimals, same digits as printf("%.*f").
+// prec < 0 : shortest decimal that reads back as v.
+size_t stx_append_double (stx_t* dst, const double v, const int prec)
+{
+#ifdef __SIZEOF_INT128__
+    const int neg = signbit(v);
+    const double mag = fabs(v);
+    uint64_t m;
+
+    if (!isfinite(v) || prec > FIXED_PREC_MAX) 
+        return append_double_slow (dst, v, prec);
+
+    if (prec >= 0) {
+        if (!scale_exact (mag, prec, &m)) return append_double_slow (dst, v, prec);
+        char* end = spare (dst, 1 + UINT_DIGITS_MAX + 1 + prec);
+        if (!end) return 0;
+        return settle (*dst, put_fixed(end, neg, m, prec));
+    }
+
+    // Fewest decimals p for which m/10^p is exactly v : 
+    // m and 10^p being exact doubles, strtod reads it back as v.
+    for (int p = 0; p <= FIXED_PREC_MAX; ++p) {
+        if (!scale_exact (mag, p, &m) || m >= (1ull << 53)) break;
+        if ((double)m / POW10[p] == mag) {
+            char* end = spare (dst, 1 + UINT_DIGITS_MAX + 1 + p);
+            if (!end) return 0;
+            return settle (*dst, put_fixed(end, neg, m, p));
+        }
+    }
+#endif
+
+    return append_double_slow (dst, v, prec);
+}
+
+
+//==== COMPILED FORMAT =========================================================
+
+// Conversions rendered natively, or through snprintf on their own spec.
+typedef enum {
+    SEG_LIT,    // literal text
+    SEG_STR,    // %s
+    SEG_INT,    // %d %i
+    SEG_UINT,   // %u
+    SEG_HEX,    // %x
+    SEG_CHAR,   // %c
+    SEG_FIXED,  // %f %.Nf
+    SEG_SPEC    // any other spec
+} SegKind;
+
+// How the argument is read from the va_list
+typedef enum {
+    ARG_NONE, ARG_INT, ARG_UINT, ARG_LONG, ARG_ULONG, 
+    ARG_LLONG, ARG_ULLONG, ARG_SIZE, ARG_DOUBLE, ARG_PTR
+} ArgKind;
+
+typedef struct {
+    uint8_t kind; // SegKind
+    uint8_t arg;  // ArgKind
+    int16_t prec; // SEG_FIXED
+    uint32_t off; // in text : literal, or NUL-terminated spec
+    uint32_t len;
+} Seg;
+
+struct stx_fmt {
+    char* text; // fmt copy, then spec copies
+    int nsegs;
+    int nargs;
+    Seg segs[];
+};
+
+typedef union {
+    long long i;
+    unsigned long long u;
+    double d;
+    const void* p;
+} Arg;
+
+#define FMT_ARGS_MAX 32
+#define FMT_DEFAULT_PREC 6
+
+
+stx_fmt* stx_fmt_compile (const char* fmt)
+{
+    const size_t fmtlen = strlen(fmt);
+    if (fmtlen > UINT32_MAX/2) return NULL;
+
+    int pct = 0;
+    for (const char* c = fmt; *c; ++c) pct += (*c == '%');
+
+    stx_fmt* f = STX_MALLOC(sizeof(stx_fmt) + (2*pct+1) * sizeof(Seg));
+    if (!f) return NULL;
+    // spec copies need at most as much again
+    f->text = STX_MALLOC(2*fmtlen + 2);
+    if (!f->text) {STX_FREE(f); return NULL;}
+    memcpy (f->text, fmt, fmtlen+1);
+    f->nsegs = 0;
+    f->nargs = 0;
+
+    size_t tail = fmtlen+1;
+    size_t i = 0;
+
+    #define PUSH(k,a,p,o,l) f->segs[f->nsegs++] = (Seg){k, a, p, o, l}
+    #define FAIL {stx_fmt_free(f); return NULL;}
+
+    while (i < fmtlen) {
+
+        const size_t beg = i;
+        while (i < fmtlen && fmt[i] != '%') ++i;
+        if (i > beg) PUSH (SEG_LIT, ARG_NONE, 0, beg, i-beg);
+        if (i == fmtlen) break;
+
+        const size_t specbeg = i++;
+
+        if (fmt[i] == '%') {
+            PUSH (SEG_LIT, ARG_NONE, 0, i, 1);
+            ++i;
+            continue;
+        }
+
+        int plain = 1; // no flag nor width
+        while (fmt[i] && strchr("-+ #0", fmt[i])) {++i; plain = 0;}
+        if (fmt[i] == '*') FAIL
+        while (isdigit((unsigned char)fmt[i])) {++i; plain = 0;}
+
+        int prec = -1;
+        if (fmt[i] == '.') {
+            ++i;
+            if (fmt[i] == '*') FAIL
+            prec = 0;
+            while (isdigit((unsigned char)fmt[i])) {
+                if (prec < 10000) prec = prec*10 + (fmt[i]-'0');
+                ++i;
+            }
+        }
+
+        // length modifier : 0 none, 'H' hh, 'h', 'l', 'L' ll, 'z'
+        char mod = 0;
+        if (fmt[i] == 'h') {mod = 'h'; ++i; if (fmt[i] == 'h') {mod = 'H'; ++i;}}
+        else if (fmt[i] == 'l') {mod = 'l'; ++i; if (fmt[i] == 'l') {mod = 'L'; ++i;}}
+        else if (fmt[i] == 'z') {mod = 'z'; ++i;}
+        else if (fmt[i] && strchr("jtLq", fmt[i])) FAIL
+
+        const char conv = fmt[i];
+        if (!conv) FAIL
+        ++i;
+
+        int kind = SEG_SPEC;
+        int arg;
+
+        switch (conv) {
+            case 'd': case 'i':
+                arg = mod == 'l' ? ARG_LONG : mod == 'L' ? ARG_LLONG : mod == 'z' ? ARG_SIZE : ARG_INT;
+                if (plain && prec < 0 && mod != 'h' && mod != 'H') kind = SEG_INT;
+                break;
+            case 'u': case 'x': case 'X': case 'o':
+                arg = mod == 'l' ? ARG_ULONG : mod == 'L' ? ARG_ULLONG : mod == 'z' ? ARG_SIZE : ARG_UINT;
+                if (plain && prec < 0 && mod != 'h' && mod != 'H') 
+                    kind = conv == 'u' ? SEG_UINT : conv == 'x' ? SEG_HEX : SEG_SPEC;
+                break;
+            case 'c':
+                if (mod) FAIL // wide
+                arg = ARG_INT;
+                if (plain) kind = SEG_CHAR;
+                break;
+            case 's':
+                if (mod) FAIL // wide
+                arg = ARG_PTR;
+                if (plain && prec < 0) kind = SEG_STR;
+                break;
+            case 'p':
+                arg = ARG_PTR;
+                break;
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                arg = ARG_DOUBLE;
+                if (prec < 0) prec = FMT_DEFAULT_PREC;
+                if (conv == 'f' && plain && prec <= FIXED_PREC_MAX) kind = SEG_FIXED;
+                break;
+            default: // %n, unknown
+                FAIL
+        }
+
+        if (f->nargs == FMT_ARGS_MAX) FAIL
+        ++f->nargs;
+
+        if (kind == SEG_SPEC) {
+            const size_t speclen = i - specbeg;
+            memcpy (f->text + tail, fmt + specbeg, speclen);
+            f->text[tail + speclen] = 0;
+            PUSH (kind, arg, 0, tail, speclen);
+            tail += speclen + 1;
+        } else {
+            PUSH (kind, arg, prec, specbeg, i - specbeg);
+        }
+    }
+
+    #undef PUSH
+    #undef FAIL
+
+    return f;
+}
+
+
+void stx_fmt_free (stx_fmt* f)
+{
+    if (!f) return;
+    STX_FREE(f->text);
+    STX_FREE(f);
+}
+
+
+static inline Arg
+read_arg (va_list* args, const int kind)
+{
+    Arg a = {0};
+    switch (kind) {
+        case ARG_INT:    a.i = va_arg(*args, int); break;
+        case ARG_UINT:   a.u = va_arg(*args, unsigned); break;
+        case ARG_LONG:   a.i = va_arg(*args, long); break;
+        case ARG_ULONG:  a.u = va_arg(*args, unsigned long); break;
+        case ARG_LLONG:  a.i = va_arg(*args, long long); break;
+        case ARG_ULLONG: a.u = va_arg(*args, unsigned long long); break;
+        case ARG_SIZE:   a.u = va_arg(*args, size_t); break;
+        case ARG_DOUBLE: a.d = va_arg(*args, double); break;
+        case ARG_PTR:    a.p = va_arg(*args, const void*); break;
+    }
+    return a;
+}
+
+// snprintf of one spec with its argument, read back in its own type
+static int
+render_spec (char* out, const size_t size, const char* spec, const int kind, const Arg a)
+{
+    switch (kind) {
+        case ARG_INT:    return snprintf (out, size, spec, (int)a.i);
+        case ARG_UINT:   return snprintf (out, size, spec, (unsigned)a.u);
+        case ARG_LONG:   return snprintf (out, size, spec, (long)a.i);
+        case ARG_ULONG:  return snprintf (out, size, spec, (unsigned long)a.u);
+        case ARG_LLONG:  return snprintf (out, size, spec, a.i);
+        case ARG_ULLONG: return snprintf (out, size, spec, a.u);
+        case ARG_SIZE:   return snprintf (out, size, spec, (size_t)a.u);
+        case ARG_DOUBLE: return snprintf (out, size, spec, a.d);
+        case ARG_PTR:    return snprintf (out, size, spec, a.p);
+    }
+    return -1;
+}
+
+
+// Read all arguments and size the output, grow once, then write.
+size_t stx_append_cfmt (stx_t* dst, const stx_fmt* f, ...)
+{
+    Arg vals[FMT_ARGS_MAX];
+    size_t lens[FMT_ARGS_MAX]; // exact length, 0 for native numbers
+    size_t bound = 0;
+    int n = 0;
+
+    va_list args;
+    va_start(args, f);
+
+    for (int k = 0; k < f->nsegs; ++k) {
+        
+        const Seg* seg = &f->segs[k];
+        if (seg->kind == SEG_LIT) {bound += seg->len; continue;}
+
+        const Arg a = read_arg (&args, seg->arg);
+        size_t len = 0;
+
+        switch (seg->kind) {
+            case SEG_STR:  len = strlen(a.p); bound += len; break;
+            case SEG_INT:  bound += UINT_DIGITS_MAX+1; break;
+            case SEG_UINT: bound += UINT_DIGITS_MAX; break;
+            case SEG_HEX:  bound += 16; break;
+            case SEG_CHAR: bound += 1; break;
+            case SEG_FIXED: {
+                #ifdef __SIZEOF_INT128__
+                uint64_t m;
+                if (isfinite(a.d) && scale_exact (fabs(a.d), seg->prec, &m)) {
+                    bound += 1 + UINT_DIGITS_MAX + 1 + seg->prec; 
+                    break;
+                }
+                #endif
+                const int r = snprintf (NULL, 0, "%.*f", seg->prec, a.d);
+                if (r < 0) {va_end(args); return 0;}
+                len = r + 1; // +1 : not native
+                bound += r;
+                break;
+            }
+            default: {
+                const int r = render_spec (NULL, 0, f->text + seg->off, seg->arg, a);
+                if (r < 0) {va_end(args); return 0;}
+                len = r;
+                bound += r;
+            }
+        }
+
+        vals[n] = a;
+        lens[n] = len;
+        ++n;
+    }
+
+    va_end(args);
+
+    char* end = spare (dst, bound);
+    if (!end) return 0;
+    n = 0;
+
+    for (int k = 0; k < f->nsegs; ++k) {
+
+        const Seg* seg = &f->segs[k];
+
+        if (seg->kind == SEG_LIT) {
+            memcpy (end, f->text + seg->off, seg->len);
+            end += seg->len;
+            continue;
+        }
+
+        const Arg a = vals[n];
+        const size_t len = lens[n];
+        ++n;
+
+        switch (seg->kind) {
+            case SEG_STR: 
+                memcpy (end, a.p, len); 
+                end += len; 
+                break;
+            case SEG_INT:
+                if (a.i < 0) *end++ = '-';
+                end = put_uint (end, a.i < 0 ? -(uint64_t)a.i : (uint64_t)a.i);
+                break;
+            case SEG_UINT: 
+                end = put_uint (end, a.u); 
+                break;
+            case SEG_HEX: {
+                static const char hex[] = "0123456789abcdef";
+                char buf[16];
+                char* p = buf + sizeof(buf);
+                uint64_t v = a.u;
+                do {*--p = hex[v & 0xf]; v >>= 4;} while (v);
+                memcpy (end, p, buf + sizeof(buf) - p);
+                end += buf + sizeof(buf) - p;
+                break;
+            }
+            case SEG_CHAR: 
+                *end++ = (char)a.i; 
+                break;
+            case SEG_FIXED: 
+                if (len) {
+                    // room for the NUL : cap sentinel at worst
+                    end += snprintf (end, len, "%.*f", seg->prec, a.d);
+                    break;
+                }
+                #ifdef __SIZEOF_INT128__
+                {
+                    uint64_t m = 0;
+                    scale_exact (fabs(a.d), seg->prec, &m);
+                    end = put_fixed (end, signbit(a.d), m, seg->prec);
+                }
+                #endif
+                break;
+            default:
+                end += render_spec (end, len+1, f->text + seg->off, seg->arg, a);
+        }
+    }
+
+    return settle (*dst, end);
+}
+
+
+int stx_resize (stx_t *ps, const size_t newcap)
+{    
+    if (!unshare(ps)) return 0;
+    stx_t s = *ps;
 
     const Type type = TYPE(s);
     const void* head = HEADT(s, type);
-    Head4 dims = hgetdims(head,type);
+    Head8 dims = hgetdims(head,type);
 
     if (newcap == dims.cap) return 1;
 
-    const Type newtype = TYPE_FOR(newcap);
-    const int sametype = (newtype == type);
-    const size_t newsize = BLOCKSZ(newtype, newcap);
+    const uint8_t attrs = PREFIXED(s);
+    const size_t pre = PREFIX_OF(attrs);
+    const Type fit = TYPE_FOR(newcap);
+    const Type newtype = (pre && fit == TYPE0) ? TYPE1 : fit; // tiny has no prefix
+    const int foreign = FLAGS(s) & FOREIGN;
+    const int sametype = (newtype == type) && !foreign;
+    const size_t newsize = heapsz(pre, newtype, newcap);
     
-    void* newhead = sametype ? STX_REALLOC((void*)head, newsize)
-                             : STX_MALLOC(newsize);
+    char* block = sametype ? hrealloc((char*)head - pre, heapsz(pre, type, dims.cap), newsize)
+                           : halloc(newsize);
 
-    if (!newhead) {
+    if (!block) {
         ERR ("stx_resize: realloc");
         return 0;
     }
     
+    void* newhead = block + pre;
     char* newdata = DATA(newhead, newtype);
     const size_t newlen = min(dims.len, newcap);
     
@@ -400,193 +1633,1359 @@ int stx_resize (stx_t *ps, const size_t newcap)
         memcpy (newdata, s, newlen); 
         newdata[newlen] = 0; //nec?
         // update type
-        FLAGS(newdata) = newtype;
-        free((void*)head);
+        setflags (newdata, newtype, attrs);
+        if (attrs & SHARED) atomic_init ((Refs*)block, atomic_load_explicit(REFS(s), memory_order_relaxed));
+        if (!foreign) hfree((char*)head - pre, heapsz(pre, type, dims.cap));
     }
     
-    hsetdims (newhead, newtype, (Head4){newcap, newlen});
+    hsetdims (newhead, newtype, (Head8){newcap, newlen});
     newdata[newcap] = 0;
+    if (attrs & HASHED) atomic_init ((HashSlot*)(block + pre - HASHSZ), 0); // may be cut
     
     *ps = newdata;
     return 1;
 }
 
 
-stx_t*
-stx_split_len (const char* src, const size_t srclen, 
-    const char* sep, const size_t seplen, int* outcnt)
+// First occurrence of pat in hay, bounded by haylen.
+// Candidates from memchr on first byte.
+static const char*
+search_mem (const char* hay, const size_t haylen, const char* pat, const size_t patlen)
+{
+    if (patlen > haylen) return NULL;
+
+    const char* last = hay + haylen - patlen; // last possible match
+    const char* cur = hay;
+
+    while ((cur = memchr(cur, pat[0], last-cur+1))) {
+        if (!memcmp(cur+1, pat+1, patlen-1)) return cur;
+        if (cur++ == last) break;
+    }
+
+    return NULL;
+}
+
+#ifdef STX_X86
+
+// Candidates are positions where both first and last pattern bytes match.
+// patlen >= 2
+
+#define SEARCH_MASK(mask, base) \
+    while (mask) { \
+        const char* cand = (base) + __builtin_ctz(mask); \
+        if (!memcmp(cand+1, pat+1, patlen-2)) return cand; \
+        mask &= mask-1; \
+    }
+
+__attribute__((target("sse2"))) static const char*
+search_sse2 (const char* hay, const size_t haylen, const char* pat, const size_t patlen)
+{
+    const __m128i first = _mm_set1_epi8(pat[0]);
+    const __m128i last = _mm_set1_epi8(pat[patlen-1]);
+    const char* cur = hay;
+    const char* end = hay + haylen - patlen + 1; // past last possible match
+
+    for (; end-cur >= 16; cur += 16) {
+        const __m128i f = _mm_loadu_si128((const __m128i*)cur);
+        const __m128i l = _mm_loadu_si128((const __m128i*)(cur+patlen-1));
+        unsigned mask = _mm_movemask_epi8 (
+            _mm_and_si128 (_mm_cmpeq_epi8(f, first), _mm_cmpeq_epi8(l, last)));
+        SEARCH_MASK (mask, cur);
+    }
+
+    return search_mem (cur, hay+haylen-cur, pat, patlen);
+}
+
+__attribute__((target("avx2"))) static const char*
+search_avx2 (const char* hay, const size_t haylen, const char* pat, const size_t patlen)
+{
+    const __m256i first = _mm256_set1_epi8(pat[0]);
+    const __m256i last = _mm256_set1_epi8(pat[patlen-1]);
+    const char* cur = hay;
+    const char* end = hay + haylen - patlen + 1; // past last possible match
+
+    for (; end-cur >= 32; cur += 32) {
+        const __m256i f = _mm256_loadu_si256((const __m256i*)cur);
+        const __m256i l = _mm256_loadu_si256((const __m256i*)(cur+patlen-1));
+        unsigned mask = _mm256_movemask_epi8 (
+            _mm256_and_si256 (_mm256_cmpeq_epi8(f, first), _mm256_cmpeq_epi8(l, last)));
+        SEARCH_MASK (mask, cur);
+    }
+
+    return search_mem (cur, hay+haylen-cur, pat, patlen);
+}
+
+#undef SEARCH_MASK
+#endif
+
+// First occurrence of pat in hay, bounded by haylen : NUL-safe, 
+// never reads past hay+haylen.
+static inline const char*
+search (const char* hay, const size_t haylen, const char* pat, const size_t patlen)
+{
+    if (!patlen) return hay;
+    if (patlen > haylen) return NULL;
+    if (patlen == 1) return memchr(hay, *pat, haylen);
+    
+    #ifdef STX_X86
+    if (__builtin_cpu_supports("avx2")) return search_avx2 (hay, haylen, pat, patlen);
+    return search_sse2 (hay, haylen, pat, patlen);
+    #else
+    return search_mem (hay, haylen, pat, patlen);
+    #endif
+}
+
+
+// Next separator in [cur,end).
+// Shared by all splitters.
+static inline const char*
+next_sep (const char* cur, const char* end, const char* sep, const size_t seplen)
+{
+    return search (cur, end-cur, sep, seplen);
+}
+
+
+// Last occurrence of pat in hay, bounded by haylen.
+static const char*
+rsearch_mem (const char* hay, const size_t haylen, const char* pat, const size_t patlen)
+{
+    if (patlen > haylen) return NULL;
+
+    for (const char* cur = hay + haylen - patlen; ; --cur) {
+        if (*cur == *pat && !memcmp(cur+1, pat+1, patlen-1)) return cur;
+        if (cur == hay) return NULL;
+    }
+}
+
+#ifdef STX_X86
+
+// Same filter as search_*, candidates taken from the highest position.
+// patlen >= 1
+
+#define RSEARCH_MASK(mask, base) \
+    while (mask) { \
+        const int bit = 31 - __builtin_clz(mask); \
+        const char* cand = (base) + bit; \
+        if (patlen == 1 || !memcmp(cand+1, pat+1, patlen-2)) return cand; \
+        mask &= ~(1u << bit); \
+    }
+
+__attribute__((target("sse2"))) static const char*
+rsearch_sse2 (const char* hay, const size_t haylen, const char* pat, const size_t patlen)
+{
+    const __m128i first = _mm_set1_epi8(pat[0]);
+    const __m128i last = _mm_set1_epi8(pat[patlen-1]);
+    const char* end = hay + haylen - patlen + 1; // past last possible match
+
+    for (; end-hay >= 16; end -= 16) {
+        const char* cur = end-16;
+        const __m128i f = _mm_loadu_si128((const __m128i*)cur);
+        const __m128i l = _mm_loadu_si128((const __m128i*)(cur+patlen-1));
+        unsigned mask = _mm_movemask_epi8 (
+            _mm_and_si128 (_mm_cmpeq_epi8(f, first), _mm_cmpeq_epi8(l, last)));
+        RSEARCH_MASK (mask, cur);
+    }
+
+    return rsearch_mem (hay, end-hay+patlen-1, pat, patlen);
+}
+
+__attribute__((target("avx2"))) static const char*
+rsearch_avx2 (const char* hay, const size_t haylen, const char* pat, const size_t patlen)
+{
+    const __m256i first = _mm256_set1_epi8(pat[0]);
+    const __m256i last = _mm256_set1_epi8(pat[patlen-1]);
+    const char* end = hay + haylen - patlen + 1; // past last possible match
+
+    for (; end-hay >= 32; end -= 32) {
+        const char* cur = end-32;
+        const __m256i f = _mm256_loadu_si256((const __m256i*)cur);
+        const __m256i l = _mm256_loadu_si256((const __m256i*)(cur+patlen-1));
+        unsigned mask = _mm256_movemask_epi8 (
+            _mm256_and_si256 (_mm256_cmpeq_epi8(f, first), _mm256_cmpeq_epi8(l, last)));
+        RSEARCH_MASK (mask, cur);
+    }
+
+    return rsearch_mem (hay, end-hay+patlen-1, pat, patlen);
+}
+
+#undef RSEARCH_MASK
+#endif
+
+// Last occurrence of pat in hay, bounded by haylen.
+static inline const char*
+rsearch (const char* hay, const size_t haylen, const char* pat, const size_t patlen)
+{
+    if (!patlen) return hay + haylen;
+    if (patlen > haylen) return NULL;
+    
+    #ifdef STX_X86
+    if (__builtin_cpu_supports("avx2")) return rsearch_avx2 (hay, haylen, pat, patlen);
+    return rsearch_sse2 (hay, haylen, pat, patlen);
+    #else
+    return rsearch_mem (hay, haylen, pat, patlen);
+    #endif
+}
+
+
+// Needles from this length go to Two-Way : linear in the worst case,
+// where the first/last filter pays a memcmp per candidate.
+#define TWOWAY_MIN 32
+
+// Two-Way (Crochemore-Perrin) state for one needle.
+// rev : needle and haystack are read backwards, to find the last match.
+typedef struct {
+    const unsigned char* pat;
+    size_t len;
+    size_t ms;      // length of the left half (critical position)
+    size_t per;     // shift after a full match
+    size_t mem0;    // prefix known to match after that shift
+    uint32_t shift[256]; // 1 + last position of each byte, 0 if absent
+} TwoWay;
+
+#define TW_AT(p, n, i) (rev ? (p)[(n)-1-(i)] : (p)[i])
+
+// Start of the maximal suffix of pat for one byte order, and its period.
+static size_t
+maxsuf (const unsigned char* pat, const size_t len, const int rev, const int greater, size_t* per)
+{
+    size_t i = 0, j = 1, k = 1, p = 1;
+
+    while (j-1+k < len) {
+        const unsigned char a = TW_AT(pat, len, i-1+k);
+        const unsigned char b = TW_AT(pat, len, j-1+k);
+        if (a == b) {
+            if (k == p) {j += p; k = 1;} else ++k;
+        } else if ((a > b) == greater) {
+            j += k; k = 1; p = j-i;
+        } else {
+            i = j++; k = p = 1;
+        }
+    }
+
+    *per = p;
+    return i;
+}
+
+static void
+twoway_init (TwoWay* tw, const char* pat, const size_t len, const int rev)
+{
+    const unsigned char* n = (const unsigned char*)pat;
+    size_t per, per2;
+    size_t ms = maxsuf(n, len, rev, 1, &per);
+    const size_t ms2 = maxsuf(n, len, rev, 0, &per2);
+    if (ms2 > ms) {ms = ms2; per = per2;}
+
+    size_t i = 0;
+    while (i < ms && TW_AT(n, len, i) == TW_AT(n, len, i+per)) ++i;
+
+    if (i == ms) {
+        tw->mem0 = len-per; // periodic : the overlap is known
+    } else {
+        tw->mem0 = 0;
+        per = (ms > len-ms+1 ? ms : len-ms+1);
+    }
+
+    memset(tw->shift, 0, sizeof tw->shift);
+    for (i = 0; i < len; ++i) tw->shift[TW_AT(n, len, i)] = (uint32_t)(i+1);
+
+    tw->pat = n;
+    tw->len = len;
+    tw->ms = ms;
+    tw->per = per;
+}
+
+// First (last if rev) occurrence of the needle in hay.
+// rev is a constant at each call, so both directions get a plain loop.
+static inline const char*
+twoway_scan (const TwoWay* tw, const char* hay, const size_t haylen, const int rev)
+{
+    const unsigned char* h = (const unsigned char*)hay;
+    const unsigned char* n = tw->pat;
+    const size_t len = tw->len;
+    const size_t ms = tw->ms;
+    size_t pos = 0;
+    size_t mem = 0;
+
+    if (len > haylen) return NULL;
+
+    while (pos <= haylen-len) {
+
+        // skip on the window's last byte
+        const size_t skip = len - tw->shift[TW_AT(h, haylen, pos+len-1)];
+        if (skip) {
+            pos += (skip < mem ? mem : skip);
+            mem = 0;
+            continue;
+        }
+
+        size_t k = (ms > mem ? ms : mem);
+        while (k < len && TW_AT(n, len, k) == TW_AT(h, haylen, pos+k)) ++k;
+        if (k < len) {
+            pos += k-ms+1;
+            mem = 0;
+            continue;
+        }
+
+        k = ms;
+        while (k > mem && TW_AT(n, len, k-1) == TW_AT(h, haylen, pos+k-1)) --k;
+        if (k <= mem) return rev ? hay+haylen-pos-len : hay+pos;
+
+        pos += tw->per;
+        mem = tw->mem0;
+    }
+
+    return NULL;
+}
+
+#undef TW_AT
+
+#ifdef STX_X86
+
+// Long needles : the first/last filter runs while verifying stays under
+// FILTER_RATIO times the scanned bytes, then Two-Way takes over.
+// Linear either way, and no slower than the filter on ordinary text.
+#define FILTER_RATIO 8
+
+// Bit i set if cur[i] and cur[i+patlen-1] match the needle ends
+__attribute__((target("sse2"))) static inline unsigned
+ends_mask (const char* cur, const size_t patlen, const char* pat)
+{
+    const __m128i f = _mm_loadu_si128((const __m128i*)cur);
+    const __m128i l = _mm_loadu_si128((const __m128i*)(cur+patlen-1));
+    return _mm_movemask_epi8 (_mm_and_si128 (
+        _mm_cmpeq_epi8(f, _mm_set1_epi8(pat[0])), 
+        _mm_cmpeq_epi8(l, _mm_set1_epi8(pat[patlen-1]))));
+}
+
+static const char*
+search_long (const TwoWay* tw, const char* hay, const size_t haylen)
+{
+    const char* pat = (const char*)tw->pat;
+    const size_t patlen = tw->len;
+    const char* cur = hay;
+    const char* end = hay + haylen - patlen + 1; // past last possible match
+    size_t spent = 0;
+
+    if (patlen > haylen) return NULL;
+
+    for (; end-cur >= 16; cur += 16) {
+        unsigned mask = ends_mask (cur, patlen, pat);
+        while (mask) {
+            const char* cand = cur + __builtin_ctz(mask);
+            if (!memcmp(cand+1, pat+1, patlen-2)) return cand;
+            spent += patlen;
+            if (spent > FILTER_RATIO * (size_t)(cand-hay) + 16*patlen) {
+                ++cand;
+                return twoway_scan (tw, cand, hay+haylen-cand, 0);
+            }
+            mask &= mask-1;
+        }
+    }
+
+    return twoway_scan (tw, cur, hay+haylen-cur, 0);
+}
+
+static const char*
+rsearch_long (const TwoWay* tw, const char* hay, const size_t haylen)
+{
+    const char* pat = (const char*)tw->pat;
+    const size_t patlen = tw->len;
+    const char* end = hay + haylen - patlen + 1; // past last possible match
+    size_t spent = 0;
+
+    if (patlen > haylen) return NULL;
+
+    for (; end-hay >= 16; end -= 16) {
+        const char* cur = end-16;
+        unsigned mask = ends_mask (cur, patlen, pat);
+        while (mask) {
+            const int bit = 31 - __builtin_clz(mask);
+            const char* cand = cur + bit;
+            if (!memcmp(cand+1, pat+1, patlen-2)) return cand;
+            spent += patlen;
+            if (spent > FILTER_RATIO * (size_t)(hay+haylen-cand) + 16*patlen)
+                return twoway_scan (tw, hay, cand-hay+patlen-1, 1);
+            mask &= ~(1u << bit);
+        }
+    }
+
+    return twoway_scan (tw, hay, end-hay+patlen-1, 1);
+}
+
+#undef FILTER_RATIO
+#else
+#define search_long(tw, hay, haylen) twoway_scan (tw, hay, haylen, 0)
+#define rsearch_long(tw, hay, haylen) twoway_scan (tw, hay, haylen, 1)
+#endif
+
+// Needle prepared once, for repeated searches.
+// memchr for one byte, SIMD filter for short needles, filter then Two-Way for long ones.
+typedef struct {
+    const char* pat;
+    size_t len;
+    int rev;
+    TwoWay tw; // len >= TWOWAY_MIN
+} Finder;
+
+static void
+finder_init (Finder* f, const char* pat, const size_t len, const int rev)
+{
+    f->pat = pat;
+    f->len = len;
+    f->rev = rev;
+    if (len >= TWOWAY_MIN) twoway_init (&f->tw, pat, len, rev);
+}
+
+static inline const char*
+finder_next (const Finder* f, const char* hay, const size_t haylen)
+{
+    if (f->rev) {
+        if (f->len >= TWOWAY_MIN) return rsearch_long (&f->tw, hay, haylen);
+        return rsearch (hay, haylen, f->pat, f->len);
+    }
+
+    if (f->len >= TWOWAY_MIN) return search_long (&f->tw, hay, haylen);
+    return search (hay, haylen, f->pat, f->len);
+}
+
+
+// Part ends being collected
+typedef struct {
+    stx_t* list;    // local, then heap
+    stx_t* local;   // caller's stack array
+    int max;
+    int cnt;
+} Parts;
+
+// Double the list, moving it off the stack if needed.
+static int
+spill (Parts* p)
+{
+    const size_t newsz = 2 * p->max * sizeof(stx_t);
+    stx_t* tmp;
+
+    if (p->list == p->local) {
+        tmp = STX_MALLOC (newsz); 
+        if (tmp) memcpy (tmp, p->list, p->cnt * sizeof(stx_t));
+    } else {
+        tmp = STX_REALLOC (p->list, newsz); 
+    }
+
+    if (!tmp) return 0;
+
+    p->list = tmp;
+    p->max *= 2;
+    return 1;
+}
+
+static inline int
+push (Parts* p, const char* end)
+{
+    // -2 : last part + sentinel
+    if (p->cnt >= p->max-2 && !spill(p)) return 0; 
+    p->list[p->cnt++] = end;
+    return 1;
+}
+
+// Single-byte separators : push every c in [cur,end)
+
+static int
+scan_byte_mem (Parts* p, const char* cur, const char* end, const char c)
+{
+    while ((cur = memchr(cur, c, end-cur))) {
+        if (!push(p, cur++)) return 0;
+    }
+    return 1;
+}
+
+#ifdef STX_X86
+
+// push positions from a 64 bytes compare mask
+#define PUSH_MASK(mask, base) \
+    while (mask) { \
+        if (!push(p, (base) + __builtin_ctzll(mask))) return 0; \
+        mask &= mask-1; \
+    }
+
+__attribute__((target("sse2"))) static int
+scan_byte_sse2 (Parts* p, const char* cur, const char* end, const char c)
+{
+    const __m128i needle = _mm_set1_epi8(c);
+    
+    #define CMP16(i) _mm_cmpeq_epi8 (_mm_loadu_si128((const __m128i*)(cur+16*i)), needle)
+    #define MASK16(v) (uint64_t)(uint16_t)_mm_movemask_epi8(v)
+
+    for (; end-cur >= 64; cur += 64) {
+        const __m128i v0 = CMP16(0), v1 = CMP16(1), v2 = CMP16(2), v3 = CMP16(3);
+        // fast skip
+        if (!_mm_movemask_epi8 (_mm_or_si128 (_mm_or_si128(v0,v1), _mm_or_si128(v2,v3)))) 
+            continue;
+        uint64_t mask = MASK16(v0) | MASK16(v1)<<16 | MASK16(v2)<<32 | MASK16(v3)<<48;
+        PUSH_MASK (mask, cur);
+    }
+
+    #undef CMP16
+    #undef MASK16
+    return scan_byte_mem (p, cur, end, c);
+}
+
+__attribute__((target("avx2"))) static int
+scan_byte_avx2 (Parts* p, const char* cur, const char* end, const char c)
+{
+    const __m256i needle = _mm256_set1_epi8(c);
+
+    #define CMP32(i) _mm256_cmpeq_epi8 (_mm256_loadu_si256((const __m256i*)(cur+32*i)), needle)
+    #define MASK32(v) (uint64_t)(uint32_t)_mm256_movemask_epi8(v)
+
+    for (; end-cur >= 128; cur += 128) {
+        const __m256i v0 = CMP32(0), v1 = CMP32(1), v2 = CMP32(2), v3 = CMP32(3);
+        // fast skip
+        if (!_mm256_movemask_epi8 (_mm256_or_si256 (_mm256_or_si256(v0,v1), _mm256_or_si256(v2,v3)))) 
+            continue;
+        uint64_t mask = MASK32(v0) | MASK32(v1)<<32;
+        PUSH_MASK (mask, cur);
+        mask = MASK32(v2) | MASK32(v3)<<32;
+        PUSH_MASK (mask, cur+64);
+    }
+
+    #undef CMP32
+    #undef MASK32
+    return scan_byte_mem (p, cur, end, c);
+}
+
+#undef PUSH_MASK
+#endif
+
+// runtime dispatch
+static int
+scan_byte (Parts* p, const char* cur, const char* end, const char c)
+{
+    #ifdef STX_X86
+    if (__builtin_cpu_supports("avx2")) return scan_byte_avx2 (p, cur, end, c);
+    return scan_byte_sse2 (p, cur, end, c);
+    #else
+    return scan_byte_mem (p, cur, end, c);
+    #endif
+}
+
+
+// Separators starting in [cur,end), greedy from cur.
+// One starting before `end` may straddle it, up to `srcend`.
+static int
+scan_range (Parts* p, const char* cur, const char* end, const char* srcend,
+    const char* sep, const size_t seplen)
+{
+    if (seplen == 1) return scan_byte (p, cur, end, *sep);
+
+    const char* limit = ((size_t)(srcend - end) > seplen-1) ? end + seplen-1 : srcend;
+
+    while ((cur = next_sep(cur, limit, sep, seplen))) {
+        if (!push(p, cur)) return 0;
+        cur += seplen;
+    }
+
+    return 1;
+}
+
+// Parallel scan : chunks of src scanned on their own, then stitched.
+// A chunk scan starts at the chunk start, while the sequential one resumes
+// after the last separator of the previous chunk. When that one straddles
+// the chunk edge, the two may disagree for self-overlapping separators 
+// (e.g. "--" in "---") : the chunk is then scanned again from there.
+
+#define SCAN_CHUNKS (STX_THREADS*8)
+#define SCAN_CHUNK_MIN (64*1024)
+
+typedef struct {
+    const char* src;
+    const char* srcend;
+    const char* sep;
+    size_t seplen;
+    size_t chunksz;
+    int nchunks;
+    Parts* parts; // by chunk
+    atomic_int failed;
+} ScanJob;
+
+static inline const char*
+chunk_beg (const ScanJob* j, const int c) {
+    return j->src + c * j->chunksz;
+}
+
+static inline const char*
+chunk_end (const ScanJob* j, const int c) {
+    return (c == j->nchunks-1) ? j->srcend : j->src + (c+1) * j->chunksz;
+}
+
+static void
+scan_chunk (void* arg, const int c)
+{
+    ScanJob* j = arg;
+    Parts* p = j->parts + c;
+    
+    if (!scan_range (p, chunk_beg(j,c), chunk_end(j,c), j->srcend, j->sep, j->seplen)) 
+        atomic_store (&j->failed, 1);
+}
+
+// Heap list of part ends as from scan(). Returns the count, 0 on failure.
+static int
+scan_parallel (const char* src, const size_t srclen, 
+    const char* sep, const size_t seplen, const int threads, stx_t** plist)
+{
+    Parts parts[SCAN_CHUNKS];
+    const size_t nmax = max(srclen / SCAN_CHUNK_MIN, (size_t)1);
+    const int nchunks = min((size_t)threads * 8, nmax);
+    ScanJob job = {.src = src, .srcend = src+srclen, .sep = sep, .seplen = seplen, 
+        .chunksz = srclen / nchunks, .nchunks = nchunks, .parts = parts};
+    atomic_init (&job.failed, 0);
+    int cnt = 0;
+
+    for (int c = 0; c < nchunks; ++c) {
+        stx_t* list = STX_MALLOC(LIST_LOCAL_MAX * sizeof(stx_t));
+        parts[c] = (Parts){list, NULL, LIST_LOCAL_MAX, 0};
+        if (!list) atomic_store (&job.failed, 1);
+    }
+
+    if (!atomic_load(&job.failed)) 
+        run_blocks (threads, nchunks, scan_chunk, &job);
+
+    if (atomic_load(&job.failed)) goto fin;
+
+    // Stitch : drop separators overlapping the previous kept one.
+    int first[SCAN_CHUNKS];
+    const char* resume = src; // past last kept separator
+    size_t total = 1; // part after last sep
+
+    for (int c = 0; c < nchunks; ++c) {
+
+        Parts* p = parts + c;
+        int f = 0;
+        while (f < p->cnt && p->list[f] < resume) ++f;
+
+        if (resume > chunk_beg(&job, c)) {
+            const char* end = chunk_end(&job, c);
+            const char* limit = ((size_t)(job.srcend - end) > seplen-1) ? end + seplen-1 : job.srcend;
+            const char* next = next_sep (resume, limit, sep, seplen);
+            const char* got = (f < p->cnt) ? p->list[f] : NULL;
+            
+            if (next != got) {
+                p->cnt = f = 0;
+                if (!scan_range (p, resume, end, job.srcend, sep, seplen)) goto fin;
+            }
+        }
+
+        first[c] = f;
+        total += p->cnt - f;
+        if (p->cnt > f) resume = p->list[p->cnt-1] + seplen;
+    }
+
+    if (total > INT_MAX-1) goto fin;
+
+    stx_t* list = STX_MALLOC((total+1) * sizeof(stx_t)); // +1: sentinel
+    if (!list) goto fin;
+
+    for (int c = 0; c < nchunks; ++c) {
+        const int n = parts[c].cnt - first[c];
+        memcpy (list + cnt, parts[c].list + first[c], n * sizeof(stx_t));
+        cnt += n;
+    }
+
+    list[cnt++] = job.srcend;
+    *plist = list;
+
+    fin:
+    for (int c = 0; c < nchunks; ++c) STX_FREE(parts[c].list);
+    return cnt;
+}
+
+// Find all parts of src.
+// Stores the end of each part into *plist, which starts as the caller's
+// `local` array, then spills to the heap.
+// Large inputs are scanned by chunks on several threads, see stx_set_parallel.
+// Returns the part count, or 0 on failure.
+static int
+scan (const char* src, const size_t srclen, 
+    const char* sep, const size_t seplen, stx_t* local, stx_t** plist)
+{
+    const int threads = par_threads_for(srclen);
+    if (threads > 1) {
+        const int cnt = scan_parallel (src, srclen, sep, seplen, threads, plist);
+        if (cnt) return cnt;
+    }
+
+    Parts p = {local, local, LIST_LOCAL_MAX, 0};
+    const char *srcend = src+srclen;
+
+    if (!scan_range (&p, src, srcend, srcend, sep, seplen)) goto fail;
+    
+    // part after last sep
+    p.list[p.cnt++] = srcend;
+    *plist = p.list;
+    return p.cnt;
+
+    fail:
+    if (p.list != local) STX_FREE(p.list);
+    *plist = local;
+    return 0;
+}
+
+// Parts from their ends, by runs on several threads. 
+// Ends are read-only here : a run reads the end before it.
+
+typedef struct {
+    const char* src;
+    const stx_t* ends;
+    stx_t* parts;
+    size_t seplen;
+    int cnt;
+    int per;
+    atomic_int failed;
+} FromJob;
+
+static void
+from_run (void* arg, const int b)
+{
+    FromJob* j = arg;
+    const int end = min((b+1) * j->per, j->cnt);
+
+    for (int i = b * j->per; i < end; ++i) {
+        const char* beg = i ? j->ends[i-1] + j->seplen : j->src;
+        j->parts[i] = from (beg, j->ends[i] - beg);
+        if (!j->parts[i]) atomic_store (&j->failed, 1);
+    }
+}
+
+static stx_t*
+from_parallel (const char* src, const stx_t* ends, const int cnt, 
+    const size_t seplen, const int threads)
+{
+    stx_t* parts = STX_MALLOC((cnt+1) * sizeof(stx_t)); // +1: sentinel
+    if (!parts) return NULL;
+
+    const int nruns = min(cnt, threads * 8);
+    FromJob job = {.src = src, .ends = ends, .parts = parts, .seplen = seplen, 
+        .cnt = cnt, .per = (cnt + nruns-1) / nruns};
+    atomic_init (&job.failed, 0);
+
+    run_blocks (threads, (cnt + job.per-1) / job.per, from_run, &job);
+
+    if (atomic_load(&job.failed)) {
+        for (int i = 0; i < cnt; ++i) if (parts[i]) stx_free(parts[i]);
+        STX_FREE(parts);
+        return NULL;
+    }
+
+    parts[cnt] = NULL; // sentinel
+    return parts;
+}
+
+
+stx_t*
+stx_split_len (const char* src, const size_t srclen, 
+    const char* sep, const size_t seplen, int* outcnt)
+{
+    int cnt = 0; 
+    stx_t* ret = NULL;
+    
+    // rem: search(s,"") == s
+    if (!seplen) goto fin;
+
+    stx_t  list_local[LIST_LOCAL_MAX]; 
+    stx_t *list;
+
+    cnt = scan (src, srclen, sep, seplen, list_local, &list);
+    if (!cnt) goto fin;
+
+    const int threads = par_threads_for(srclen);
+    if (threads > 1 && cnt > 1) {
+        ret = from_parallel (src, list, cnt, seplen, threads);
+        if (list != list_local) STX_FREE(list);
+        if (!ret) cnt = 0;
+        goto fin;
+    }
+
+    // part ends -> parts, in place
+    const char *beg = src;
+
+    for (int i = 0; i < cnt; ++i) {
+        const char *end = list[i];
+        list[i] = from(beg, end-beg);
+        beg = end + seplen;
+    }
+
+    if (list != list_local) {
+        ret = list;  
+    } else {
+        ret = STX_MALLOC((cnt+1) * sizeof(stx_t)); // +1: sentinel
+        if (!ret) {cnt = 0; goto fin;}
+        memcpy (ret, list, cnt * sizeof(stx_t));
+    }
+
+    ret[cnt] = NULL; // sentinel
+
+    fin:
+    *outcnt = cnt;
+    return ret;
+}
+
+
+// The list and all parts in a single block, from heap or arena `a`.
+// Parts are flagged FOREIGN : stx_free() ignores them, growth relocates them.
+static stx_t*
+split_pack (stx_arena* a, const char* src, const size_t srclen, 
+    const char* sep, const size_t seplen, int* outcnt)
+{
+    int cnt = 0; 
+    stx_t* ret = NULL;
+    
+    if (!seplen) goto fin;
+
+    stx_t  list_local[LIST_LOCAL_MAX]; 
+    stx_t *list;
+
+    cnt = scan (src, srclen, sep, seplen, list_local, &list);
+    if (!cnt) goto fin;
+
+    // measure
+    const size_t listsz = (cnt+1) * sizeof(stx_t); // +1: sentinel
+    size_t blocksz = listsz;
+    const char *beg = src;
+
+    for (int i = 0; i < cnt; ++i) {
+        const size_t len = list[i]-beg;
+        const Type type = TYPE_FOR(len);
+        blocksz = HALIGN(blocksz, type) + BLOCKSZ(type, len);
+        beg = list[i] + seplen;
+    }
+
+    char* block = a ? arena_alloc (a, blocksz, sizeof(stx_t)) : STX_MALLOC(blocksz + LOAD_PAD);
+    
+    if (block) {
+
+        ret = (stx_t*)block;
+        size_t off = listsz;
+        beg = src;
+
+        for (int i = 0; i < cnt; ++i) {
+            const size_t len = list[i]-beg;
+            const Type type = TYPE_FOR(len);
+            off = HALIGN(off, type);
+
+            void* head = block + off;
+            hsetdims(head, type, (Head8){len, len});
+            char* data = DATA(head, type);
+            memcpy (data, beg, len);
+            data[len] = 0;
+            setflags (data, type, FOREIGN);
+            
+            ret[i] = data;
+            off += BLOCKSZ(type, len);
+            beg = list[i] + seplen;
+        }
+
+        ret[cnt] = NULL; // sentinel
+    
+    } else {
+        cnt = 0;
+    }
+
+    if (list != list_local) STX_FREE(list);
+
+    fin:
+    *outcnt = cnt;
+    return ret;
+}
+
+
+// Same as stx_split_len, but parts are views into src : no copy.
+// The list is a single block, ended by a {NULL,0} sentinel.
+stx_view*
+stx_split_view (const char* src, const size_t srclen, 
+    const char* sep, const size_t seplen, int* outcnt)
+{
+    int cnt = 0; 
+    stx_view* ret = NULL;
+    
+    if (!seplen) goto fin;
+
+    stx_t  list_local[LIST_LOCAL_MAX]; 
+    stx_t *list;
+
+    cnt = scan (src, srclen, sep, seplen, list_local, &list);
+    if (!cnt) goto fin;
+
+    ret = STX_MALLOC((cnt+1) * sizeof(stx_view)); // +1: sentinel
+    
+    if (ret) {
+        const char *beg = src;
+        for (int i = 0; i < cnt; ++i) {
+            ret[i] = (stx_view){beg, list[i]-beg};
+            beg = list[i] + seplen;
+        }
+        ret[cnt] = (stx_view){NULL, 0};
+    } else {
+        cnt = 0;
+    }
+
+    if (list != list_local) STX_FREE(list);
+
+    fin:
+    *outcnt = cnt;
+    return ret;
+}
+
+
+void
+stx_split_iter (stx_iter* it, const char* src, const size_t srclen, 
+    const char* sep, const size_t seplen)
+{
+    *it = (stx_iter){seplen ? src : NULL, src+srclen, sep, seplen};
+}
+
+
+// Yields the next part into *part. Returns 0 when exhausted.
+int
+stx_split_next (stx_iter* it, stx_view* part)
+{
+    const char* cur = it->cur;
+    if (!cur) return 0;
+
+    const char* found = next_sep (cur, it->end, it->sep, it->seplen);
+
+    if (found) {
+        *part = (stx_view){cur, found-cur};
+        it->cur = found + it->seplen;
+    } else {
+        *part = (stx_view){cur, it->end-cur};
+        it->cur = NULL;
+    }
+
+    return 1;
+}
+
+
+stx_t*
+stx_split_pack (const char* src, const size_t srclen, 
+    const char* sep, const size_t seplen, int* outcnt)
+{
+    return split_pack (NULL, src, srclen, sep, seplen, outcnt);
+}
+
+
+// Works for both stx_split_len and stx_split_pack lists
+void
+stx_list_free (const stx_t *list)
+{
+    const stx_t *l = list;
+    stx_t s;
+    while ((s = *l++)) stx_free(s); 
+    STX_FREE((void*)list);
+}
+
+
+// Parts cut in blocks of `per` : each block has its output offset
+#define JOIN_BLOCKS (STX_THREADS*8)
+
+typedef struct {
+    const stx_t* list;
+    int count;
+    int per;
+    const char* sep;
+    size_t seplen;
+    char* out;
+    const size_t* offs;
+} JoinJob;
+
+// Parts of block b, each followed by sep but the very last
+static void
+join_block (void* arg, const int b)
+{
+    const JoinJob* j = arg;
+    const int beg = b * j->per;
+    const int end = min(beg + j->per, j->count);
+    char* cur = j->out + j->offs[b];
+
+    for (int i = beg; i < end; ++i) {
+        const size_t len = getlen(j->list[i]);
+        memcpy (cur, j->list[i], len);
+        cur += len;
+        if (i == j->count-1) break;
+        memcpy (cur, j->sep, j->seplen);
+        cur += j->seplen;
+    }
+}
+
+// Lengths summed by block, so that a large output can be 
+// copied by block from several threads, see stx_set_parallel.
+static stx_t 
+join (stx_arena* a, stx_t *list, const int count, const char* sep, const size_t seplen)
+{
+    if (count <= 0) return new_in(a, 0);
+
+    const int per = (count + JOIN_BLOCKS-1) / JOIN_BLOCKS;
+    const int nblocks = (count + per-1) / per;
+    size_t offs[JOIN_BLOCKS+1];
+    size_t totlen = 0;
+
+    for (int b = 0; b < nblocks; ++b) {
+        offs[b] = totlen;
+        const int end = min((b+1)*per, count);
+        for (int i = b*per; i < end; ++i)
+            totlen += getlen(list[i]);
+        totlen += (end - b*per) * seplen;
+    }
+    totlen -= seplen; // none after last
+    
+    stx_t ret = new_in(a, totlen);
+    if (!ret) return NULL;
+    char* cur = (char*)ret;
+
+    const int threads = par_threads_for(totlen);
+
+    if (threads > 1 && nblocks > 1) {
+        JoinJob job = {list, count, per, sep, seplen, cur, offs};
+        run_blocks (threads, nblocks, join_block, &job);
+        setlen(ret, totlen);
+        return ret;
+    }
+
+    for (int i = 0; i < count-1; ++i) {
+        stx_t elt = list[i];
+        const size_t eltlen = getlen(elt);
+        memcpy(cur, elt, eltlen);
+        cur += eltlen;
+        memcpy(cur, sep, seplen);
+        cur += seplen;
+    }
+
+    stx_t last = list[count-1];
+    memcpy(cur, last, getlen(last));
+
+    setlen(ret, totlen);
+    return ret;
+}
+
+
+stx_t 
+stx_join_len (stx_t *list, const int count, const char* sep, const size_t seplen)
+{
+    return join (NULL, list, count, sep, seplen);
+}
+
+
+// Trim set as a 256-bit map : one bit per byte value.
+typedef struct { uint64_t bits[4]; } Charset;
+
+// ' ' '\t' '\n' '\v' '\f' '\r' : isspace() in the C locale
+static const Charset SPACES = {{(1ull << ' ') | (0x1full << '\t'), 0, 0, 0}};
+
+static inline int
+inset (const Charset* set, const unsigned char c)
+{
+    return (set->bits[c >> 6] >> (c & 63)) & 1;
+}
+
+static Charset
+charset (const char* chars)
+{
+    Charset set = {{0}};
+    for (const unsigned char* c = (const unsigned char*)chars; *c; ++c)
+        set.bits[*c >> 6] |= 1ull << (*c & 63);
+    return set;
+}
+
+#ifdef STX_X86
+// Bit i set if p[i] is white space
+__attribute__((target("sse2"))) static inline unsigned
+space_mask (const char* p)
+{
+    const __m128i v = _mm_loadu_si128((const __m128i*)p);
+    const __m128i c = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+    // '\t'..'\r' : c <= 4 unsigned
+    const __m128i ctl = _mm_cmpeq_epi8(_mm_min_epu8(c, _mm_set1_epi8(4)), c);
+    const __m128i spc = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+    return _mm_movemask_epi8(_mm_or_si128(ctl, spc));
+}
+#endif
+
+// First byte of [cur,end) not in set
+static const char*
+skip_front (const Charset* set, const char* cur, const char* end)
+{
+    #ifdef STX_X86
+    if (set == &SPACES) {
+        for (; end-cur >= 16; cur += 16) {
+            const unsigned keep = ~space_mask(cur) & 0xffff;
+            if (keep) return cur + __builtin_ctz(keep);
+        }
+    }
+    #endif
+
+    while (cur < end && inset(set, *cur)) ++cur;
+    return cur;
+}
+
+// Past the last byte of [beg,end) not in set.
+// Only touches the trailing run, plus one vector.
+static const char*
+skip_back (const Charset* set, const char* beg, const char* end)
+{
+    #ifdef STX_X86
+    if (set == &SPACES) {
+        for (; end-beg >= 16; end -= 16) {
+            const unsigned keep = ~space_mask(end-16) & 0xffff;
+            if (keep) return end-16 + (32 - __builtin_clz(keep));
+        }
+    }
+    #endif
+
+    while (end > beg && inset(set, *(end-1))) --end;
+    return end;
+}
+
+// The head sits before the data, so a left trim can't just advance the
+// pointer : the remainder is moved down, once.
+static void
+trim (stx_t s, const Charset* set, const int side)
+{
+    if (readonly(s)) {ERR("stx_trim: read-only"); return;}
+
+    const char* front = s;
+    const char* end = s + getlen(s);
+
+    if (side & STX_LEFT) front = skip_front(set, front, end);
+    if (side & STX_RIGHT) end = skip_back(set, front, end);
+    
+    const size_t newlen = end-front;
+    
+    if (front > s) {
+        memmove((void*)s, front, newlen);
+    }
+    
+    ((char*)s)[newlen] = 0;
+    setlen(s,newlen);
+}
+
+
+// todo new fit type ?
+void stx_trim (stx_t s)
+{
+    trim (s, &SPACES, STX_BOTH);
+}
+
+void stx_ltrim (stx_t s)
+{
+    trim (s, &SPACES, STX_LEFT);
+}
+
+void stx_rtrim (stx_t s)
 {
-    int cnt = 0; 
-    stx_t* ret = NULL;
-    
-    // rem: strstr(s,"") == s
-    if (!seplen) goto fin;
+    trim (s, &SPACES, STX_RIGHT);
+}
 
-    stx_t  list_local[LIST_LOCAL_MAX]; 
-    stx_t *list_dyn = NULL;
-    stx_t *list_reloc = NULL;
-    stx_t *list = list_local;
-    int listmax = LIST_LOCAL_MAX;
+void stx_trim_chars (stx_t s, const char* chars, stx_side side)
+{
+    if (!chars) {ERR("stx_trim_chars: NULL chars"); return;}
+    const Charset set = charset(chars);
+    trim (s, &set, side);
+}
 
-    const char *beg = src;
-    const char *end = src;
 
-    while ((end = strstr(end, sep))) {
+// copy only up to current length, in the narrowest head that fits
+static stx_t 
+dup_in (stx_arena* a, stx_t src)
+{
+    return from_in (a, src, getlen(src));
+}
 
-        if (cnt >= listmax-2) { // -2 : last part + sentinel
+// A shared strick gets one more reference
+stx_t stx_dup (stx_t src) {
+    if (IS_SHARED(src)) {
+        atomic_fetch_add_explicit (REFS(src), 1, memory_order_relaxed);
+        return src;
+    }
+    return dup_in (NULL, src);
+}
 
-            if (list == list_local) {
 
-                list_reloc = list_pool;
-                listmax = LIST_POOL_MAX;
+// nb: memcmp(,,0) == 0
+int stx_equal (stx_t a, stx_t b) 
+{
+    const size_t lena = getlen(a);
+    const size_t lenb = getlen(b);
+    if (lena != lenb) return 0;
 
-            } else {
+    // cached hashes that differ
+    if (IS_HASHED(a) && IS_HASHED(b)) {
+        const uint64_t ha = atomic_load_explicit (HASHSLOT(a), memory_order_relaxed);
+        const uint64_t hb = atomic_load_explicit (HASHSLOT(b), memory_order_relaxed);
+        if (ha && hb && ha != hb) return 0;
+    }
 
-                listmax *= 2;
-                const size_t newsz = listmax * sizeof(stx_t);
+    return !memcmp(a, b, lena);
+}
 
-                if (list == list_pool) {
 
-                    list_dyn = STX_MALLOC (newsz); 
-                    if (!list_dyn) {cnt = 0; goto fin;}
-                    list_reloc = list_dyn;
-                
-                } else { 
+// Cached in the hash slot if any, computed at first call.
+// Racing threads store the same value : relaxed is enough.
+uint64_t stx_hash (stx_t s)
+{
+    if (!IS_HASHED(s)) return hash_mem (s, getlen(s));
 
-                    list = STX_REALLOC (list, newsz); 
-                    if (!list) {cnt = 0; goto fin;}
-                }
-            }
-        
-            if (list_reloc) {
-                memcpy (list_reloc, list, cnt * sizeof(stx_t));
-                list = list_reloc;
-                list_reloc = NULL;
-            }
-        }
+    HashSlot* slot = HASHSLOT(s);
+    uint64_t h = atomic_load_explicit (slot, memory_order_relaxed);
+    if (!h) {
+        h = hash_mem (s, getlen(s));
+        atomic_store_explicit (slot, h, memory_order_relaxed);
+    }
+    return h;
+}
+
+
+// Move to a heap block with prefix slots for `attrs`, refcount 1.
+// Tiny ones get a TYPE1 head. A cached hash is kept.
+static int
+rebase (stx_t* ps, const uint8_t attrs)
+{
+    stx_t s = *ps;
+    const Type type = TYPE(s);
+    const Head8 dims = hgetdims(HEADT(s, type), type);
+    const Type newtype = type ? type : TYPE1;
+    const size_t pre = PREFIX_OF(attrs);
 
-        list[cnt++] = from(beg, end-beg);
+    char* block = halloc(heapsz(pre, newtype, dims.cap));
+    if (!block) {ERR("rebase: alloc"); return 0;}
 
-        end += seplen;
-        beg = end;
-    };
+    void* head = block + pre;
+    hsetdims (head, newtype, dims);
     
-    // part after last sep
-    list[cnt++] = from(beg, src+srclen-beg);
+    char* data = DATA(head, newtype);
+    memcpy (data, s, dims.len+1);
+    data[dims.cap] = 0;
+    setflags (data, newtype, attrs);
 
-    if (list == list_dyn) {
-        ret = list;  
-    } else {
-        ret = STX_MALLOC((cnt+1) * sizeof(stx_t)); // +1: sentinel
-        if (!ret) {cnt = 0; goto fin;}
-        memcpy (ret, list, cnt * sizeof(stx_t));
-    }
+    if (attrs & HASHED) atomic_init (HASHSLOT(data), 
+        IS_HASHED(s) ? atomic_load_explicit(HASHSLOT(s), memory_order_relaxed) : 0);
+    if (attrs & SHARED) atomic_init (REFS(data), 1);
 
-    ret[cnt] = NULL; // sentinel
+    stx_free(s); // not if foreign, drops one reference if shared
+    *ps = data;
 
-    fin:
-    *outcnt = cnt;
-    return ret;
+    return 1;
 }
 
+int stx_hash_enable (stx_t* ps)
+{
+    if (IS_HASHED(*ps)) return 1;
+    return rebase (ps, PREFIXED(*ps) | HASHED);
+}
 
-void
-stx_list_free (const stx_t *list)
+int stx_share_enable (stx_t* ps)
 {
-    const stx_t *l = list;
-    stx_t s;
-    while ((s = *l++)) STX_FREE(HEAD(s)); 
-    STX_FREE((void*)list);
+    if (IS_SHARED(*ps)) return 1;
+    return rebase (ps, PREFIXED(*ps) | SHARED);
 }
 
+// References to a shared strick, 1 for others
+size_t stx_refs (stx_t s)
+{
+    return IS_SHARED(s) ? atomic_load_explicit(REFS(s), memory_order_acquire) : 1;
+}
 
-stx_t 
-stx_join_len (stx_t *list, const int count, const char* sep, const size_t seplen)
+
+int stx_view_equal (stx_view a, stx_view b) 
 {
-    size_t totlen = 0;
+    return (a.len == b.len) && !memcmp(a.data, b.data, a.len);
+}
 
-    for (int i = 0; i < count; ++i)
-        totlen += getlen(list[i]);
-    totlen += (count-1)*seplen;
-    
-    stx_t ret = new(totlen);
-    char* cur = (char*)ret;
 
-    for (int i = 0; i < count-1; ++i) {
-        stx_t elt = list[i];
-        const size_t eltlen = getlen(elt);
-        memcpy(cur, elt, eltlen);
-        cur += eltlen;
-        memcpy(cur, sep, seplen);
-        cur += seplen;
-    }
+// Offset of first pat in v, or -1
+long long stx_view_find (stx_view v, const char* pat, const size_t patlen)
+{
+    Finder f;
+    finder_init (&f, pat, patlen, 0);
+    const char* found = finder_next (&f, v.data, v.len);
+    return found ? found - v.data : -1;
+}
 
-    stx_t last = list[count-1];
-    memcpy(cur, last, getlen(last));
 
-    setlen(ret, totlen);
-    return ret;
+// Offset of first pat in s, or -1
+long long stx_find (stx_t s, const char* pat, const size_t patlen)
+{
+    return stx_view_find (stx_view_of(s), pat, patlen);
 }
 
 
-// todo new fit type ?
-void stx_trim (stx_t s)
+// Offset of last pat in s, or -1
+long long stx_rfind (stx_t s, const char* pat, const size_t patlen)
 {
-    const char* front = s;
-    while (isspace(*front)) ++front;
+    Finder f;
+    finder_init (&f, pat, patlen, 1);
+    const char* found = finder_next (&f, s, getlen(s));
+    return found ? found - s : -1;
+}
+
+
+// Non-overlapping occurrences of pat in s
+size_t stx_count (stx_t s, const char* pat, const size_t patlen)
+{
+    if (!patlen) return 0;
 
+    Finder f;
+    finder_init (&f, pat, patlen, 0);
+    const char* cur = s;
     const char* end = s + getlen(s);
-    while (end > front && isspace(*(end-1))) --end;
-    
-    const size_t newlen = end-front;
-    
-    if (front > s) {
-        memmove((void*)s, front, newlen);
+    size_t n = 0;
+
+    while ((cur = finder_next (&f, cur, end-cur))) {
+        cur += patlen;
+        ++n;
     }
-    
-    ((char*)s)[newlen] = 0;
-    setlen(s,newlen);
+
+    return n;
 }
 
 
-// copy only up to current length
-stx_t stx_dup (stx_t src)
+// Offsets of the non-overlapping occurrences of pat in s.
+// Free with STX_FREE.
+size_t* stx_find_all (stx_t s, const char* pat, const size_t patlen, int* outcnt)
 {
-    const Type type = TYPE(src);
-    const void* head = HEADT(src, type);
-    const size_t len = hgetlen(head, type);
-    const size_t cpysz = BLOCKSZ(type,len);
-    void* new_head = malloc(cpysz);
+    size_t cap = 16;
+    size_t* ret = STX_MALLOC(cap * sizeof(*ret));
+    *outcnt = 0;
+    
+    if (!ret) {ERR("stx_find_all: malloc"); return NULL;}
+    if (!patlen) return ret;
 
-    if (!new_head) return NULL;
+    Finder f;
+    finder_init (&f, pat, patlen, 0);
+    const char* cur = s;
+    const char* end = s + getlen(s);
+    size_t n = 0;
 
-    memcpy (new_head, head, cpysz);
-    hsetcap (new_head, type, len);
-    stx_t ret = DATA(new_head, type);
-    ((char*)ret)[len] = 0;
+    while ((cur = finder_next (&f, cur, end-cur))) {
 
-    return ret;
-}
+        if (n == cap) {
+            size_t* tmp = STX_REALLOC(ret, 2 * cap * sizeof(*ret));
+            if (!tmp) {ERR("stx_find_all: realloc"); STX_FREE(ret); return NULL;}
+            ret = tmp;
+            cap *= 2;
+        }
 
+        ret[n++] = cur - s;
+        cur += patlen;
+    }
 
-// nb: memcmp(,,0) == 0
-int stx_equal (stx_t a, stx_t b) 
-{
-    const size_t lena = getlen(a);
-    const size_t lenb = getlen(b);
-    return (lena == lenb) && !memcmp(a, b, lena);
+    *outcnt = (int)n;
+    return ret;
 }
 
 
 size_t stx_spc (stx_t s)
 {
     const Type type = TYPE(s);
-    void* head = HEADT(s, type);
-    switch(type) { 
-        case TYPE4: return ((Head4*)head)->cap - ((Head4*)head)->len;
-        case TYPE1: return ((Head1*)head)->cap - ((Head1*)head)->len;
-        default: ERR("Bad head type"); exit(1);
-    }  
+    const Head8 dims = hgetdims(HEADT(s, type), type);
+    return dims.cap - dims.len;
 }
 
 
@@ -599,11 +2998,25 @@ void stx_dbg (stx_t s)
     const Type type = TYPE(s);
 
     switch(type){
+        case TYPE0: {
+            printf(DBGFMT, hgetcap(head, type), hgetlen(head, type), FLAGS(s), s);
+            break;
+        }
+        case TYPE8: {
+            Head8* h = (Head8*)head;
+            printf(DBGFMT, DBGARG);
+            break;
+        }
         case TYPE4: {
             Head4* h = (Head4*)head;
             printf(DBGFMT, DBGARG);
             break;
         }
+        case TYPE2: {
+            Head2* h = (Head2*)head;
+            printf(DBGFMT, DBGARG);
+            break;
+        }
         case TYPE1: {
             Head1* h = (Head1*)head;
             printf(DBGFMT, DBGARG);
@@ -632,7 +3045,20 @@ stx_t stx_from_len (const void* src, const size_t srclen) {
 }
 
 void stx_free (stx_t s) {
-    STX_FREE(HEAD(s));
+    if (FLAGS(s) & FOREIGN) return;
+    // last reference frees
+    if (IS_SHARED(s) && atomic_fetch_sub_explicit(REFS(s), 1, memory_order_acq_rel) > 1) return;
+    const Type type = TYPE(s);
+    const size_t pre = PREFIX(s);
+    hfree(HEADT(s,type) - pre, heapsz(pre, type, hgetcap(HEADT(s,type), type)));
+}
+
+stx_view stx_view_of (stx_t s) {
+    return (stx_view){s, getlen(s)};
+}
+
+stx_t stx_from_view (stx_view v) {
+    return from(v.data, v.len);
 }
 
 stx_t* stx_split (const char* src, const char* sep, int* outcnt) {
@@ -646,11 +3072,13 @@ stx_t stx_join (stx_t *list, int count, const char* sep) {
 }
 
 void stx_reset (stx_t s) {
+    if (readonly(s)) {ERR("stx_reset: read-only"); return;}
     setlen(s,0);
     *((char*)s) = 0;
 } 
 
 void stx_adjust (stx_t s) {
+    if (readonly(s)) {ERR("stx_adjust: read-only"); return;}
     setlen(s, strlen(s));
 }
 
@@ -660,4 +3088,352 @@ size_t stx_cap (stx_t s) {
 
 size_t stx_len (stx_t s) {
     return getlen(s);
-}
\ No newline at end of file
+}
+
+//==== ARENA API ===============================================================
+
+stx_arena* stx_arena_create (const size_t chunksz)
+{
+    stx_arena* a = STX_MALLOC(sizeof(stx_arena));
+    if (!a) return NULL;
+
+    a->chunksz = chunksz ? chunksz : STX_ARENA_CHUNK;
+    a->chunk = chunk_new(a->chunksz);
+    
+    if (!a->chunk) {
+        STX_FREE(a);
+        return NULL;
+    }
+
+    return a;
+}
+
+// Release all stricks, keep the first chunk for reuse.
+void stx_arena_reset (stx_arena* a)
+{
+    Chunk* c = a->chunk;
+    while (c->next) {
+        Chunk* next = c->next;
+        STX_FREE(c);
+        c = next;
+    }
+    c->used = 0;
+    a->chunk = c;
+}
+
+void stx_arena_destroy (stx_arena* a)
+{
+    stx_arena_reset(a);
+    STX_FREE(a->chunk);
+    STX_FREE(a);
+}
+
+stx_t stx_arena_new (stx_arena* a, const size_t cap) {
+    return new_in(a, cap);
+}
+
+stx_t stx_arena_from_len (stx_arena* a, const void* src, const size_t srclen) {
+    return from_in(a, src, srclen);
+}
+
+stx_t stx_arena_dup (stx_arena* a, stx_t src) {
+    return dup_in(a, src);
+}
+
+stx_t* stx_arena_split_len (stx_arena* a, const char* src, const size_t srclen, 
+    const char* sep, const size_t seplen, int* outcnt) {
+    return split_pack(a, src, srclen, sep, seplen, outcnt);
+}
+
+stx_t stx_arena_join_len (stx_arena* a, stx_t *list, const int count, 
+    const char* sep, const size_t seplen) {
+    return join(a, list, count, sep, seplen);
+}
+
+size_t stx_arena_append (stx_arena* a, stx_t* dst, const void* src, const size_t srclen) {
+    return append(a, dst, src, srclen);
+}
+
+//==== INTERN ==================================================================
+
+// One arena-backed open-addressing table per shard.
+// Interned stricks are FOREIGN : stx_free() ignores them, so a list 
+// holding them still goes through stx_list_free().
+
+#define INTERN_SHARDS_LOG 4 // concurrent mode
+#define INTERN_SLOTS 64 // initial, power of 2
+#define INTERN_BATCH 256 // stx_intern_list : hashes computed ahead
+
+typedef struct {
+    uint64_t hash;
+    stx_t str; // NULL if free
+} Atom;
+
+typedef struct {
+    pthread_mutex_t lock;
+    stx_arena* arena;
+    Atom* slots;
+    size_t mask; // slot count - 1
+    size_t count;
+} Shard;
+
+struct stx_interns {
+    int concurrent;
+    int nshards;
+    Shard shards[];
+};
+
+// Top hash bits pick the shard, low bits the slot.
+static inline int
+shard_of (const stx_interns* t, const uint64_t hash) {
+    return t->concurrent ? (int)(hash >> (64 - INTERN_SHARDS_LOG)) : 0;
+}
+
+// Slot holding src, or free slot where it goes
+static inline Atom*
+probe (const Shard* sh, const uint64_t hash, const char* src, const size_t len)
+{
+    size_t i = hash & sh->mask;
+
+    for (;;) {
+        Atom* at = sh->slots + i;
+        if (!at->str) return at;
+        if (at->hash == hash && getlen(at->str) == len && !memcmp(at->str, src, len)) 
+            return at;
+        i = (i+1) & sh->mask;
+    }
+}
+
+static int
+shard_grow (Shard* sh)
+{
+    const size_t n = 2*(sh->mask+1);
+    Atom* slots = STX_CALLOC(n, sizeof(Atom));
+    if (!slots) {ERR("intern: alloc"); return 0;}
+
+    for (size_t i = 0; i <= sh->mask; ++i) {
+        const Atom at = sh->slots[i];
+        if (!at.str) continue;
+        size_t j = at.hash & (n-1);
+        while (slots[j].str) j = (j+1) & (n-1);
+        slots[j] = at;
+    }
+
+    STX_FREE(sh->slots);
+    sh->slots = slots;
+    sh->mask = n-1;
+    return 1;
+}
+
+// Read-only arena copy. FROZEN needs a non-tiny flags byte.
+static stx_t
+frozen_in (stx_arena* a, const char* src, const size_t len)
+{
+    const Type fit = TYPE_FOR(len);
+    const Type type = fit ? fit : TYPE1;
+    void* head = arena_alloc (a, BLOCKSZ(type, len), FIELDSZ(type));
+    if (!head) return NULL;
+
+    hsetdims(head, type, (Head8){len, len});
+
+    char* data = DATA(head,type);
+    memcpy (data, src, len);
+    data[len] = 0; 
+
+    setflags (data, type, FOREIGN|FROZEN);
+
+    return data;
+}
+
+// Caller holds the shard lock in concurrent mode.
+static stx_t
+intern_in (Shard* sh, const uint64_t hash, const char* src, const size_t len)
+{
+    Atom* at = probe (sh, hash, src, len);
+    if (at->str) return at->str;
+
+    // load factor 1/2
+    if (2*(sh->count+1) > sh->mask+1) {
+        if (!shard_grow(sh)) return NULL;
+        at = probe (sh, hash, src, len);
+    }
+
+    stx_t s = frozen_in (sh->arena, src, len);
+    if (!s) return NULL;
+
+    *at = (Atom){hash, s};
+    ++sh->count;
+
+    return s;
+}
+
+
+stx_interns* stx_interns_create (const int concurrent)
+{
+    const int n = concurrent ? 1 << INTERN_SHARDS_LOG : 1;
+    stx_interns* t = STX_MALLOC(sizeof(stx_interns) + n*sizeof(Shard));
+    if (!t) return NULL;
+
+    t->concurrent = !!concurrent;
+    t->nshards = 0;
+
+    for (int k = 0; k < n; ++k) {
+        Shard* sh = t->shards + k;
+        sh->arena = stx_arena_create(0);
+        sh->slots = STX_CALLOC(INTERN_SLOTS, sizeof(Atom));
+        sh->mask = INTERN_SLOTS-1;
+        sh->count = 0;
+        pthread_mutex_init (&sh->lock, NULL);
+        ++t->nshards;
+
+        if (!sh->arena || !sh->slots) {
+            stx_interns_destroy(t);
+            return NULL;
+        }
+    }
+
+    return t;
+}
+
+void stx_interns_destroy (stx_interns* t)
+{
+    for (int k = 0; k < t->nshards; ++k) {
+        Shard* sh = t->shards + k;
+        if (sh->arena) stx_arena_destroy(sh->arena);
+        STX_FREE(sh->slots);
+        pthread_mutex_destroy(&sh->lock);
+    }
+    STX_FREE(t);
+}
+
+// Not synchronized with concurrent interning
+size_t stx_interns_count (const stx_interns* t)
+{
+    size_t n = 0;
+    for (int k = 0; k < t->nshards; ++k) n += t->shards[k].count;
+    return n;
+}
+
+// The one strick with this content.
+stx_t stx_intern (stx_interns* t, const void* src, const size_t srclen)
+{
+    const uint64_t hash = hash_mem (src, srclen);
+    Shard* sh = t->shards + shard_of(t, hash);
+
+    if (!t->concurrent) return intern_in (sh, hash, src, srclen);
+
+    pthread_mutex_lock (&sh->lock);
+    stx_t s = intern_in (sh, hash, src, srclen);
+    pthread_mutex_unlock (&sh->lock);
+
+    return s;
+}
+
+// Replace each part by its interned strick, releasing the part.
+// By batch : parts bucketed by shard, each shard locked once.
+int stx_intern_list (stx_interns* t, stx_t* list, const int count)
+{
+    uint64_t hashes[INTERN_BATCH];
+    short order[INTERN_BATCH]; // batch indexes by shard
+    int bounds[(1 << INTERN_SHARDS_LOG) + 1];
+
+    for (int beg = 0; beg < count; beg += INTERN_BATCH) {
+
+        stx_t* part = list + beg;
+        const int n = min(count - beg, INTERN_BATCH);
+
+        memset (bounds, 0, sizeof(bounds));
+
+        for (int i = 0; i < n; ++i) {
+            hashes[i] = hash_mem (part[i], getlen(part[i]));
+            ++bounds[shard_of(t, hashes[i]) + 1];
+        }
+        for (int k = 0; k < t->nshards; ++k) 
+            bounds[k+1] += bounds[k];
+        
+        int fill[1 << INTERN_SHARDS_LOG];
+        memcpy (fill, bounds, sizeof(fill));
+        for (int i = 0; i < n; ++i) 
+            order[fill[shard_of(t, hashes[i])]++] = i;
+
+        for (int k = 0; k < t->nshards; ++k) {
+
+            if (bounds[k] == bounds[k+1]) continue;
+            Shard* sh = t->shards + k;
+            if (t->concurrent) pthread_mutex_lock (&sh->lock);
+
+            for (int o = bounds[k]; o < bounds[k+1]; ++o) {
+
+                const int i = order[o];
+                stx_t s = intern_in (sh, hashes[i], part[i], getlen(part[i]));
+                
+                if (!s) {
+                    if (t->concurrent) pthread_mutex_unlock (&sh->lock);
+                    return 0;
+                }
+
+                if (s != part[i]) {
+                    stx_free (part[i]);
+                    part[i] = s;
+                }
+            }
+
+            if (t->concurrent) pthread_mutex_unlock (&sh->lock);
+        }
+    }
+
+    return 1;
+}
+
+//==== GROWTH ==================================================================
+
+void stx_set_growth (const stx_growth policy)
+{
+    growth = policy;
+}
+
+// threads 0 : online CPUs, up to STX_THREADS. 1 : never parallel.
+void stx_set_parallel (const int threads, const size_t min_bytes)
+{
+    par_threads = threads;
+    par_min = min_bytes;
+}
+
+// Ensure room for `extra` more bytes, reserving exactly that.
+int stx_reserve (stx_t *ps, const size_t extra)
+{
+    if (!unshare(ps)) return 0;
+    stx_t s = *ps;
+    const Type type = TYPE(s);
+    const void* head = HEADT(s, type);
+    const Head8 dims = hgetdims(head, type);
+
+    if (dims.cap - dims.len >= extra) return 1;
+    if (extra > SIZE_MAX/2 - dims.len) {ERR("stx_reserve: too large"); return 0;}
+
+    if (!grow(NULL, ps, dims.len + extra, head, type, dims, 0)) {
+        ERR("stx_reserve: grow");
+        return 0;
+    }
+
+    return 1;
+}
+
+//==== POOL API ================================================================
+
+// Release the calling thread's cached blocks.
+void stx_pool_drain()
+{
+    #ifdef STX_POOL
+    for (size_t c = 0; c < POOL_CLASSES; ++c) {
+        Slot* slot = pool_slots[c];
+        while (slot) {
+            Slot* next = slot->next;
+            STX_FREE(slot);
+            slot = next;
+        }
+        pool_slots[c] = NULL;
+        pool_count[c] = 0;
+    }
+    #endif
+}
@@ -19,10 +19,18 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #ifndef STRICKS_H
 #define STRICKS_H
 
+#include <stdint.h>
 #include <string.h>
 
 // Allocators
 
+#if !defined(STX_MALLOC) && !defined(STX_REALLOC)
+	#define STX_SYSTEM_ALLOC
+#endif
+
+// Custom allocators may tell real block size for growth slack
+// #define STX_USABLE_SIZE(block) my_usable_size(block)
+
 #ifndef STX_MALLOC
 	#define STX_MALLOC malloc
 #endif
@@ -45,12 +53,69 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 	#define STX_LOCAL_MEM 1024
 #endif
 
-#ifndef STX_LIST_POOL_MEM
-	#define STX_LIST_POOL_MEM 16*1024*1024
+// Max growth step of STX_GROW_CAPPED
+#ifndef STX_GROW_STEP
+	#define STX_GROW_STEP 64*1024*1024
+#endif
+
+// With STX_POOL, blocks kept per size class and thread
+#ifndef STX_POOL_KEEP
+	#define STX_POOL_KEEP 1024
+#endif
+
+#ifndef STX_ARENA_CHUNK
+	#define STX_ARENA_CHUNK 64*1024
+#endif
+
+// Parallel join : max threads, and default output size to start at
+#ifndef STX_THREADS
+	#define STX_THREADS 8
+#endif
+
+#ifndef STX_PAR_MIN
+	#define STX_PAR_MIN 32*1024*1024
 #endif
 
 typedef const char* stx_t;
 
+// Read-only window into a strick or any buffer
+typedef struct {
+	const char* data;
+	size_t len;
+} stx_view;
+
+// How appenders reserve capacity for `needed` bytes
+typedef enum {
+	STX_GROW_DOUBLE,	// 2 * needed (default)
+	STX_GROW_HALF,		// 1.5 * needed
+	STX_GROW_CAPPED,	// 2 * needed, at most needed + STX_GROW_STEP
+	STX_GROW_ROUND		// needed, with block rounded to power of 2 or page multiple
+} stx_growth;
+
+// Trim sides, see stx_trim_chars
+typedef enum {
+	STX_LEFT = 1,
+	STX_RIGHT = 2,
+	STX_BOTH = 3
+} stx_side;
+
+// Bulk allocator, see stx_arena_create
+typedef struct stx_arena stx_arena;
+
+// Interning table, see stx_interns_create
+typedef struct stx_interns stx_interns;
+
+// Pre-parsed format, see stx_fmt_compile
+typedef struct stx_fmt stx_fmt;
+
+// Lazy split state
+typedef struct {
+	const char* cur; // next part, NULL when done
+	const char* end;
+	const char* sep;
+	size_t seplen;
+} stx_iter;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -63,22 +128,48 @@ stx_t	stx_from_len (const void* src, size_t srclen);
 stx_t	stx_dup (stx_t src);
 stx_t*	stx_split (const char* src, const char* sep, int* outcnt);
 stx_t*	stx_split_len (const char* src, size_t srclen, const char* sep, size_t seplen, int* outcnt);
+stx_t*	stx_split_pack (const char* src, size_t srclen, const char* sep, size_t seplen, int* outcnt);
 stx_t 	stx_join (stx_t *list, int count, const char* sep);
 stx_t 	stx_join_len (stx_t *list, int count, const char* sep, size_t seplen);
+void	stx_set_parallel (int threads, size_t min_bytes);
+
+// Views
+
+stx_view*	stx_split_view (const char* src, size_t srclen, const char* sep, size_t seplen, int* outcnt);
+stx_view	stx_view_of (stx_t s);
+stx_t		stx_from_view (stx_view v);
+int			stx_view_equal (stx_view a, stx_view b);
+long long	stx_view_find (stx_view v, const char* pat, size_t patlen);
+void		stx_split_iter (stx_iter* it, const char* src, size_t srclen, const char* sep, size_t seplen);
+int			stx_split_next (stx_iter* it, stx_view* part);
 
 // Append
 
 size_t		stx_append (stx_t* dst, const void* src, size_t srclen);
+size_t		stx_appendv (stx_t* dst, const stx_view* parts, int count);
+size_t		stx_append_many (stx_t* dst, ...);
 long long	stx_append_strict (stx_t dst, const void* src, size_t srclen);
 size_t		stx_append_fmt (stx_t* dst, const char* fmt, ...);
 long long	stx_append_fmt_strict (stx_t dst, const char* fmt, ...);
+size_t		stx_append_int (stx_t* dst, long long v);
+size_t		stx_append_uint (stx_t* dst, unsigned long long v);
+size_t		stx_append_hex (stx_t* dst, unsigned long long v);
+size_t		stx_append_double (stx_t* dst, double v, int prec);
+stx_fmt*	stx_fmt_compile (const char* fmt);
+size_t		stx_append_cfmt (stx_t* dst, const stx_fmt* f, ...);
+void		stx_fmt_free (stx_fmt* f);
 
 // Adjust / reset
 
 int		stx_resize (stx_t *pstx, size_t newcap);
+int		stx_reserve (stx_t *pstx, size_t extra);
+void	stx_set_growth (stx_growth policy);
 void	stx_reset (stx_t s);
 void	stx_adjust (stx_t s);
 void	stx_trim (stx_t s);
+void	stx_ltrim (stx_t s);
+void	stx_rtrim (stx_t s);
+void	stx_trim_chars (stx_t s, const char* chars, stx_side side);
 
 // Free
 
@@ -91,8 +182,43 @@ size_t	stx_cap (stx_t s); // capacity accessor
 size_t	stx_len (stx_t s); // length accessor
 size_t	stx_spc (stx_t s); // remaining space
 int		stx_equal (stx_t a, stx_t b);
+uint64_t	stx_hash (stx_t s);
+int		stx_hash_enable (stx_t* ps);
+int		stx_share_enable (stx_t* ps);
+size_t		stx_refs (stx_t s);
 void 	stx_dbg (stx_t s);
 
+// Search
+
+long long	stx_find (stx_t s, const char* pat, size_t patlen);
+long long	stx_rfind (stx_t s, const char* pat, size_t patlen);
+size_t		stx_count (stx_t s, const char* pat, size_t patlen);
+size_t*		stx_find_all (stx_t s, const char* pat, size_t patlen, int* outcnt);
+
+// Arena
+
+stx_arena*	stx_arena_create (size_t chunksz);
+void		stx_arena_reset (stx_arena* a);
+void		stx_arena_destroy (stx_arena* a);
+stx_t		stx_arena_new (stx_arena* a, size_t cap);
+stx_t		stx_arena_from_len (stx_arena* a, const void* src, size_t srclen);
+stx_t		stx_arena_dup (stx_arena* a, stx_t src);
+stx_t*		stx_arena_split_len (stx_arena* a, const char* src, size_t srclen, const char* sep, size_t seplen, int* outcnt);
+stx_t		stx_arena_join_len (stx_arena* a, stx_t *list, int count, const char* sep, size_t seplen);
+size_t		stx_arena_append (stx_arena* a, stx_t* dst, const void* src, size_t srclen);
+
+// Intern
+
+stx_interns*	stx_interns_create (int concurrent);
+void		stx_interns_destroy (stx_interns* t);
+size_t		stx_interns_count (const stx_interns* t);
+stx_t		stx_intern (stx_interns* t, const void* src, size_t srclen);
+int		stx_intern_list (stx_interns* t, stx_t* list, int count);
+
+// Pool (STX_POOL)
+
+void		stx_pool_drain (void);
+
 // Shorthands
 
 #define stx_cat		stx_append
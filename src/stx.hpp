@@ -0,0 +1,280 @@
+/*
+Stricks - Managed C strings library
+Copyright (C) 2021 - Francois Alcover <francois[@]alcover.fr>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// C++17 formatting with the format parsed at compile time :
+//
+//   stx::append (&s, STX_FMT("%s has %d apples\n"), name, count);
+//
+// Conversions : %s %d %i %u %x %c %f %.Nf %g (shortest round-trip) %%.
+// No flags nor width. Argument count and types are checked at compile time.
+// Integers narrower than int are promoted first, like printf does.
+// All pieces go out in a single stx_appendv : one growth at most.
+
+#ifndef STX_HPP
+#define STX_HPP
+
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "stx.h"
+
+// Format literal as a type, usable as a constant expression
+#define STX_FMT(str) ([] { \
+    struct Fmt { static constexpr std::string_view value() { return str; } }; \
+    return Fmt{}; }())
+
+namespace stx {
+
+namespace detail {
+
+struct Spec {
+    size_t litbeg = 0; // literal text before the spec
+    size_t litlen = 0;
+    size_t end = 0;    // past the spec
+    char conv = 0;
+    int prec = -1;
+};
+
+constexpr bool is_digit (char c) {return c >= '0' && c <= '9';}
+
+// Number of specs, %% included
+constexpr size_t count_specs (std::string_view f)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < f.size(); ++i) {
+        if (f[i] != '%') continue;
+        if (++i == f.size()) throw "stx: trailing % in format";
+        ++n;
+    }
+    return n;
+}
+
+// Errors surface as a throw in constant evaluation, i.e. at compile time
+template <class F>
+constexpr auto parse()
+{
+    constexpr std::string_view f = F::value();
+    std::array<Spec, count_specs(f)> specs{};
+    size_t beg = 0;
+    size_t k = 0;
+
+    for (size_t i = 0; i < f.size(); ++i) {
+
+        if (f[i] != '%') continue;
+
+        Spec sp;
+        sp.litbeg = beg;
+        sp.litlen = i - beg;
+        ++i;
+
+        if (f[i] == '.') {
+            sp.prec = 0;
+            while (++i < f.size() && is_digit(f[i])) sp.prec = sp.prec*10 + (f[i]-'0');
+        }
+
+        if (i == f.size()) throw "stx: unterminated spec";
+        sp.conv = f[i];
+
+        switch (sp.conv) {
+            case 's': case 'd': case 'i': case 'u': case 'x': case 'c': case '%':
+                if (sp.prec >= 0) throw "stx: precision only for %f";
+                break;
+            case 'f':
+                if (sp.prec < 0) sp.prec = 6;
+                break;
+            case 'g':
+                if (sp.prec >= 0) throw "stx: %g is shortest, no precision";
+                break;
+            default:
+                throw "stx: unsupported conversion";
+        }
+
+        sp.end = beg = i+1;
+        specs[k++] = sp;
+    }
+
+    return specs;
+}
+
+// Argument index of each spec, -1 for %%
+template <class F>
+constexpr auto arg_indexes()
+{
+    constexpr auto specs = parse<F>();
+    std::array<int, specs.size()> idx{};
+    int n = 0;
+    for (size_t k = 0; k < specs.size(); ++k)
+        idx[k] = (specs[k].conv == '%') ? -1 : n++;
+    return idx;
+}
+
+template <class F>
+constexpr size_t arg_count()
+{
+    size_t n = 0;
+    for (int i : arg_indexes<F>()) n += (i >= 0);
+    return n;
+}
+
+// Render room for a number
+constexpr size_t room (char conv, int prec)
+{
+    switch (conv) {
+        case 'd': case 'i': case 'u': return 21;
+        case 'x': return 16;
+        case 'c': return 1;
+        case 'g': return 32;
+        case 'f': return 1 + 309 + 1 + prec; // up to DBL_MAX
+        default: return 0;
+    }
+}
+
+// Offset of each spec in the render buffer, total last
+template <class F>
+constexpr auto buf_offsets()
+{
+    constexpr auto specs = parse<F>();
+    std::array<size_t, specs.size() + 1> off{};
+    for (size_t k = 0; k < specs.size(); ++k)
+        off[k+1] = off[k] + room(specs[k].conv, specs[k].prec);
+    return off;
+}
+
+template <class T> using bare = std::remove_cv_t<std::remove_reference_t<T>>;
+
+// Integer promotion, as for printf's variadic arguments : char -1 is %x ffffffff
+template <class T> using promoted = decltype(+std::declval<bare<T>>());
+
+template <class T>
+constexpr bool is_text = std::is_convertible_v<const T&, std::string_view>
+                      || std::is_same_v<bare<T>, stx_view>;
+
+template <class T>
+constexpr bool is_int = std::is_integral_v<bare<T>> && !std::is_same_v<bare<T>, bool>;
+
+template <char conv, class T>
+constexpr bool accepts()
+{
+    switch (conv) {
+        case 's': return is_text<T>;
+        case 'd': case 'i': case 'u': case 'x': case 'c': return is_int<T>;
+        case 'f': case 'g': return std::is_arithmetic_v<bare<T>>;
+        default: return false;
+    }
+}
+
+template <class T>
+stx_view text_of (const T& v)
+{
+    if constexpr (std::is_same_v<bare<T>, stx_view>) {
+        return v;
+    } else {
+        const std::string_view sv(v);
+        return {sv.data(), sv.size()};
+    }
+}
+
+template <char conv, int prec, class T>
+stx_view render (char* buf, const T& v)
+{
+    char* const last = buf + room(conv, prec);
+    std::to_chars_result r{};
+
+    if constexpr (conv == 's') {
+        return text_of(v);
+    } else if constexpr (conv == 'c') {
+        buf[0] = static_cast<char>(v);
+        return {buf, 1};
+    } else if constexpr (conv == 'x') {
+        r = std::to_chars (buf, last, static_cast<std::make_unsigned_t<promoted<T>>>(v), 16);
+    } else if constexpr (conv == 'u') {
+        r = std::to_chars (buf, last, static_cast<std::make_unsigned_t<promoted<T>>>(v));
+    } else if constexpr (conv == 'f') {
+        r = std::to_chars (buf, last, static_cast<double>(v), std::chars_format::fixed, prec);
+    } else if constexpr (conv == 'g') {
+        r = std::to_chars (buf, last, static_cast<double>(v));
+    } else {
+        r = std::to_chars (buf, last, v);
+    }
+
+    return {buf, static_cast<size_t>(r.ptr - buf)};
+}
+
+template <class F, class Tuple, size_t... K>
+size_t append (stx_t* dst, const Tuple& args, std::index_sequence<K...>)
+{
+    constexpr std::string_view f = F::value();
+    constexpr size_t bufsz = buf_offsets<F>().back();
+
+    char buf[bufsz ? bufsz : 1];
+    stx_view parts[2*sizeof...(K) + 1];
+    int n = 0;
+
+    // literal before spec k, then its rendering
+    auto emit = [&](auto k) {
+        constexpr Spec sp = parse<F>()[k];
+        parts[n++] = {f.data() + sp.litbeg, sp.litlen};
+        if constexpr (sp.conv == '%') {
+            parts[n++] = {"%", 1};
+        } else {
+            const auto& v = std::get<arg_indexes<F>()[k]>(args);
+            static_assert (accepts<sp.conv, decltype(v)>(), "stx: argument type does not match conversion");
+            parts[n++] = render<sp.conv, sp.prec>(buf + buf_offsets<F>()[k], v);
+        }
+    };
+
+    (emit (std::integral_constant<size_t, K>{}), ...);
+    (void)emit;
+
+    constexpr size_t tail = sizeof...(K) ? parse<F>()[sizeof...(K)-1].end : 0;
+    parts[n++] = {f.data() + tail, f.size() - tail};
+
+    return stx_appendv (dst, parts, n);
+}
+
+} // namespace detail
+
+
+// Append to *dst with format F, see STX_FMT.
+// Returns the new length, 0 on error.
+template <class F, class... Args>
+size_t append (stx_t* dst, F, const Args&... args)
+{
+    static_assert (detail::arg_count<F>() == sizeof...(Args), "stx: format/argument count mismatch");
+    constexpr size_t nspecs = detail::parse<F>().size();
+    return detail::append<F> (dst, std::forward_as_tuple(args...), std::make_index_sequence<nspecs>{});
+}
+
+// New strick formatted with F
+template <class F, class... Args>
+stx_t format (F fmt, const Args&... args)
+{
+    stx_t s = stx_new(0);
+    if (s) append (&s, fmt, args...);
+    return s;
+}
+
+} // namespace stx
+
+#endif